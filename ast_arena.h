@@ -0,0 +1,138 @@
+#ifndef AST_ARENA_H
+#define AST_ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Storage for the parser's AST and the semantic passes' symbol entries.
+// Everything belongs to one compilation unit and is freed all at once by
+// clear() or the destructor; nothing is deleted one node at a time.
+
+// 32-bit index of a node in a NodePool<T>. Half the size of a pointer, and
+// typed so that an expression index cannot be used as a statement.
+template <typename T>
+struct NodeRef {
+    static const uint32_t NONE = UINT32_MAX;
+
+    uint32_t index = NONE;
+
+    explicit operator bool() const { return index != NONE; }
+    bool operator==(NodeRef other) const { return index == other.index; }
+    bool operator!=(NodeRef other) const { return index != other.index; }
+};
+
+// A run of consecutive nodes in a NodePool<T>, such as the statements of a
+// body or the fields of a record, which are added together once the list
+// is complete.
+template <typename T>
+struct NodeRange {
+    uint32_t first = 0;
+    uint32_t count = 0;
+
+    bool empty() const { return count == 0; }
+};
+
+// All nodes of one type, stored contiguously in creation order. The
+// parser creates nodes roughly in source order, so a pass walking a
+// routine reads mostly sequential memory. T should be a small aggregate
+// that refers to other nodes by NodeRef/NodeRange, not by pointer, since
+// adding nodes may move the array.
+template <typename T>
+class NodePool {
+public:
+    template <typename... Args>
+    NodeRef<T> add(Args&&... args) {
+        nodes.push_back(T{ std::forward<Args>(args)... });
+        return NodeRef<T>{ static_cast<uint32_t>(nodes.size() - 1) };
+    }
+
+    // Appends [begin, end) as one range, e.g. from the parser's scratch
+    // vector for the list being built.
+    template <typename Iterator>
+    NodeRange<T> addRange(Iterator begin, Iterator end) {
+        uint32_t first = static_cast<uint32_t>(nodes.size());
+        nodes.insert(nodes.end(), begin, end);
+        return NodeRange<T>{ first, static_cast<uint32_t>(nodes.size()) - first };
+    }
+
+    T& operator[](NodeRef<T> ref) { return nodes[ref.index]; }
+    const T& operator[](NodeRef<T> ref) const { return nodes[ref.index]; }
+
+    T* begin(NodeRange<T> range) { return nodes.data() + range.first; }
+    T* end(NodeRange<T> range) { return nodes.data() + range.first + range.count; }
+    const T* begin(NodeRange<T> range) const { return nodes.data() + range.first; }
+    const T* end(NodeRange<T> range) const { return nodes.data() + range.first + range.count; }
+
+    size_t size() const { return nodes.size(); }
+    void reserve(size_t n) { nodes.reserve(n); }
+    void clear() { nodes.clear(); }
+
+private:
+    std::vector<T> nodes;
+};
+
+// Bump allocator for objects that do not fit a NodePool: variable-sized
+// data or objects that need a stable address. Only trivially destructible
+// types can be made, since nothing is destroyed individually.
+class Arena {
+public:
+    static const size_t BLOCK_SIZE = 64 * 1024;
+
+    Arena() : cursor(nullptr), blockEnd(nullptr), used(0) {}
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+    Arena(Arena&&) = default;
+    Arena& operator=(Arena&&) = default;
+
+    void* allocate(size_t size, size_t align = alignof(std::max_align_t)) {
+        uintptr_t p = (reinterpret_cast<uintptr_t>(cursor) + align - 1) & ~(static_cast<uintptr_t>(align) - 1);
+        if (!cursor || p + size > reinterpret_cast<uintptr_t>(blockEnd)) {
+            // Objects larger than a block get a block of their own
+            size_t blockSize = size + align > BLOCK_SIZE ? size + align : BLOCK_SIZE;
+            blocks.emplace_back(new char[blockSize]);
+            cursor = blocks.back().get();
+            blockEnd = cursor + blockSize;
+            p = (reinterpret_cast<uintptr_t>(cursor) + align - 1) & ~(static_cast<uintptr_t>(align) - 1);
+        }
+        cursor = reinterpret_cast<char*>(p + size);
+        used += size;
+        return reinterpret_cast<void*>(p);
+    }
+
+    template <typename T, typename... Args>
+    T* make(Args&&... args) {
+        static_assert(std::is_trivially_destructible<T>::value, "Arena objects are never destroyed");
+        return new (allocate(sizeof(T), alignof(T))) T{ std::forward<Args>(args)... };
+    }
+
+    // Uninitialized array of n Ts
+    template <typename T>
+    T* makeArray(size_t n) {
+        static_assert(std::is_trivially_destructible<T>::value, "Arena objects are never destroyed");
+        return static_cast<T*>(allocate(sizeof(T) * n, alignof(T)));
+    }
+
+    size_t bytesUsed() const { return used; }
+
+    // Frees everything at once. Keeps the first block for the next unit.
+    void clear() {
+        if (blocks.size() > 1) blocks.resize(1);
+        cursor = blocks.empty() ? nullptr : blocks[0].get();
+        blockEnd = blocks.empty() ? nullptr : cursor + BLOCK_SIZE;
+        used = 0;
+    }
+
+private:
+    std::vector<std::unique_ptr<char[]>> blocks;
+    char* cursor;
+    char* blockEnd;
+    size_t used;
+};
+
+#endif // AST_ARENA_H
@@ -0,0 +1,95 @@
+#!/bin/sh
+# Differential test of the lexer's fast paths against a reference scanner.
+#
+# Usage: bench/differential.sh [runs] [size]      (default: 200 runs of JOBS * 64K + 256K)
+#
+# The reference is the pinned scanner in bench/reference.l: literal keyword
+# rules, plain whitespace and comment rules and istream input, so neither
+# the keyword hash nor the SIMD skips are checked against themselves. Each
+# run generates a bench/gen_fuzz input from a new seed and compares, against
+# the reference, the output, exit status and error messages of the working
+# tree lexer in each mode: plain, --mmap, -j, --pipeline and --cache, in both
+# output formats, with and without SIMD. All runs use --recover. Inputs that
+# show a difference are kept in KEEP. tokenizeParallel() gives each thread
+# at least 64K, so inputs must be at least JOBS * 64K for the -j modes to
+# cut chunks at all; smaller sizes are refused. Environment:
+#   FLEX, CXX, CXXFLAGS  tools and flags used for the build
+#   REFERENCE            flex spec of the reference scanner
+#                        (default: bench/reference.l)
+#   JOBS                 thread count for the -j modes (default: 4)
+#   KEEP                 directory for failing inputs (default: bench/fuzz-failures)
+#   SEED                 first seed (default: 1)
+set -e
+
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+FLEX=${FLEX:-flex}
+CXX=${CXX:-g++}
+CXXFLAGS=${CXXFLAGS:--std=c++17 -O2 -pthread}
+REFERENCE=${REFERENCE:-$ROOT/bench/reference.l}
+JOBS=${JOBS:-4}
+KEEP=${KEEP:-$ROOT/bench/fuzz-failures}
+SEED=${SEED:-1}
+RUNS=${1:-200}
+SIZE=${2:-$((JOBS * 64 + 256))K}
+
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+sh "$ROOT/bench/literal_keywords.sh" "$REFERENCE" "$WORK/reference.l"
+$FLEX -o "$WORK/reference.yy.cc" "$WORK/reference.l"
+$CXX $CXXFLAGS -I"$ROOT" "$WORK/reference.yy.cc" -o "$WORK/reference"
+
+$FLEX -o "$WORK/lex.yy.cc" "$ROOT/lexer.l"
+$CXX $CXXFLAGS -I"$ROOT" "$WORK/lex.yy.cc" -o "$WORK/lexer"
+$CXX $CXXFLAGS -DLEXER_NO_SIMD -I"$ROOT" "$WORK/lex.yy.cc" -o "$WORK/lexer-scalar"
+$CXX $CXXFLAGS "$ROOT/bench/gen_fuzz.cpp" -o "$WORK/gen_fuzz"
+
+MODES="plain --mmap -j$JOBS --pipeline --mmap,-j$JOBS --cache"
+
+# run <lexer> <format> <mode> <input> <output>: prints the exit status and
+# keeps the error lines (--pipeline adds queue statistics on stderr)
+run() {
+    lexer=$1 format=$2 mode=$3 input=$4 output=$5
+    [ "$mode" = plain ] && mode=""
+    [ "$mode" = --cache ] && mode="--cache=$WORK/cache"
+    mode=$(echo "$mode" | sed 's/-j\([0-9]\)/-j \1/; s/,/ /g')
+    status=0
+    # shellcheck disable=SC2086
+    "$lexer" --recover --max-errors=1000000 --format="$format" $mode "$input" "$output" \
+        2> "$output.stderr" > /dev/null || status=$?
+    grep ': error: ' "$output.stderr" > "$output.errors" || true
+    echo "$status"
+}
+
+failures=0
+seed=$SEED
+end=$((SEED + RUNS))
+while [ $seed -lt $end ]; do
+    input=$WORK/input.i
+    "$WORK/gen_fuzz" "$seed" "$SIZE" "$input"
+    if [ "$(wc -c < "$input")" -lt $((JOBS * 65536)) ]; then
+        echo "Error: $SIZE inputs are too small for -j$JOBS to split; use at least $((JOBS * 64))K" >&2
+        exit 1
+    fi
+    for format in text binary; do
+        want=$(run "$WORK/reference" "$format" plain "$input" "$WORK/want")
+        for lexer in lexer lexer-scalar; do
+            for mode in $MODES; do
+                got=$(run "$WORK/$lexer" "$format" "$mode" "$input" "$WORK/got")
+                # --cache is run twice: the second run reads the cache entry
+                [ "$mode" = --cache ] && got=$(run "$WORK/$lexer" "$format" "$mode" "$input" "$WORK/got")
+                if [ "$got" != "$want" ] || ! cmp -s "$WORK/want" "$WORK/got" \
+                    || ! cmp -s "$WORK/want.errors" "$WORK/got.errors"; then
+                    echo "seed $seed: $lexer --format=$format $mode differs from the reference" >&2
+                    mkdir -p "$KEEP"
+                    cp "$input" "$KEEP/seed-$seed.i"
+                    failures=$((failures + 1))
+                fi
+            done
+        done
+    done
+    seed=$((seed + 1))
+done
+
+echo "$RUNS inputs, $failures differences"
+[ $failures -eq 0 ]
@@ -0,0 +1,157 @@
+// Generates synthetic I-language sources for the lexer benchmarks.
+//
+// Usage: gen_corpus <keywords|identifiers|numbers|comments|whitespace> <size> <output_file>
+//
+// size takes a K, M or G suffix. Output is a pure function of the mix and
+// the size: the generator uses raw mt19937 output with a fixed seed, which
+// the standard pins down exactly, so corpora are identical on every
+// platform.
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+
+namespace {
+
+std::mt19937 rng(20240901);
+
+uint32_t pick(uint32_t n) {
+    return rng() % n;
+}
+
+const char* const NAMES[] = {
+    "x", "i", "n", "sum", "count", "result", "total_value", "matrix_row",
+    "node_buffer", "accumulator", "left_index", "right_bound", "temp1", "temp2",
+    "particle_velocity_x", "particle_velocity_y", "_hidden", "recordArray",
+};
+
+const char* const TYPES[] = { "integer", "real", "boolean" };
+const char* const OPS[] = { "+", "-", "*", "/", "%" };
+const char* const RELS[] = { "<", "<=", ">", ">=", "=", "/=" };
+const char* const LOGIC[] = { "and", "or", "xor" };
+
+std::string name() {
+    return NAMES[pick(sizeof(NAMES) / sizeof(NAMES[0]))];
+}
+
+std::string longName() {
+    std::string s = name();
+    for (uint32_t parts = 1 + pick(3); parts > 0; parts--) s += "_" + name();
+    return s;
+}
+
+std::string number() {
+    if (pick(3) == 0) return std::to_string(pick(100000)) + "." + std::to_string(pick(100000));
+    return std::to_string(pick(1000000));
+}
+
+void indent(std::string& out, int depth) {
+    out.append(static_cast<size_t>(depth) * 4, ' ');
+}
+
+// One line of source in the style of the given mix.
+void line(std::string& out, const std::string& mix, int depth) {
+    indent(out, depth);
+    if (mix == "keywords") {
+        switch (pick(6)) {
+        case 0: out += "var " + name() + " : " + TYPES[pick(3)] + " is " + (pick(2) ? "true" : "false") + ";\n"; break;
+        case 1: out += "if not " + name() + " " + LOGIC[pick(3)] + " " + name() + " then return " + name() + "; else print " + name() + "; end\n"; break;
+        case 2: out += "for " + name() + " in reverse " + name() + " .. " + name() + " loop print " + name() + "; end\n"; break;
+        case 3: out += "while " + name() + " loop " + name() + " := " + name() + "; end\n"; break;
+        case 4: out += "type " + name() + " is record var " + name() + " : real; end\n"; break;
+        default: out += "routine " + name() + " ( " + name() + " : array [ size ] integer ) is return " + name() + "; end\n"; break;
+        }
+    } else if (mix == "identifiers") {
+        out += longName() + " := " + longName() + " " + OPS[pick(5)] + " " + longName() + "[" + longName() + "]." + longName();
+        out += " " + std::string(RELS[pick(6)]) + " " + longName() + ";\n";
+    } else if (mix == "numbers") {
+        out += name() + " := " + number();
+        for (uint32_t terms = 2 + pick(6); terms > 0; terms--) out += std::string(" ") + OPS[pick(5)] + " " + number();
+        out += ";\n";
+    } else if (mix == "whitespace") {
+        // Column-aligned code: padding between tokens, tabs, trailing
+        // blanks and runs of empty lines. One pick() per statement, so the
+        // draws come in a fixed order.
+        out.append(pick(3), '\t');
+        out += name();
+        out.append(1 + pick(24), ' ');
+        out += ":=";
+        out.append(1 + pick(8), ' ');
+        out += name();
+        out += " ";
+        out += OPS[pick(5)];
+        out.append(1 + pick(12), ' ');
+        out += number();
+        out += ";";
+        char blank = pick(2) ? ' ' : '\t';
+        out.append(pick(6), blank);
+        size_t newlines = pick(4) == 0 ? 1 + pick(5) : 1;
+        out.append(newlines, '\n');
+    } else {
+        if (pick(4) == 0) {
+            out += name() + " := " + name() + " + 1; // " + longName() + " " + longName() + "\n";
+        } else {
+            out += "// " + longName() + " " + longName() + " " + longName() + " " + longName() + "\n";
+        }
+        if (pick(3) == 0) out += "\n";
+    }
+}
+
+uint64_t parseSize(const char* text) {
+    char* end;
+    uint64_t size = strtoull(text, &end, 10);
+    switch (*end) {
+    case 'K': case 'k': return size << 10;
+    case 'M': case 'm': return size << 20;
+    case 'G': case 'g': return size << 30;
+    default: return size;
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc != 4) {
+        fprintf(stderr, "Usage: %s <keywords|identifiers|numbers|comments|whitespace> <size> <output_file>\n", argv[0]);
+        return 1;
+    }
+    std::string mix = argv[1];
+    if (mix != "keywords" && mix != "identifiers" && mix != "numbers" && mix != "comments" && mix != "whitespace") {
+        fprintf(stderr, "Error: Unknown mix '%s'\n", argv[1]);
+        return 1;
+    }
+    uint64_t size = parseSize(argv[2]);
+
+    FILE* out = fopen(argv[3], "wb");
+    if (!out) {
+        fprintf(stderr, "Error: Cannot open output file '%s'\n", argv[3]);
+        return 1;
+    }
+
+    // Indentation depth drifts to vary the whitespace runs. The last block
+    // is cut back to a line boundary so no token is split at the end.
+    std::string block;
+    uint64_t written = 0;
+    int depth = 1;
+    while (written < size) {
+        block.clear();
+        while (block.size() < (1 << 20)) {
+            line(block, mix, depth);
+            if (pick(8) == 0) depth = 1 + static_cast<int>(pick(6));
+        }
+        if (written + block.size() > size) {
+            size_t keep = static_cast<size_t>(size - written);
+            while (keep > 0 && block[keep - 1] != '\n') keep--;
+            if (keep == 0) keep = static_cast<size_t>(size - written);
+            block.resize(keep);
+            size = written + keep;
+        }
+        fwrite(block.data(), 1, block.size(), out);
+        written += block.size();
+    }
+    fclose(out);
+    return 0;
+}
@@ -0,0 +1,130 @@
+// Generates random I-language inputs for bench/differential.sh.
+//
+// Usage: gen_fuzz <seed> <size> <output_file>
+//
+// Unlike gen_corpus, the output is not meant to look like real programs.
+// It strings together lexemes chosen to hit the scanner's edge cases:
+// keywords glued to identifiers, number forms such as "1.", "1..2" and
+// ".5", operators written without spaces, whitespace runs of every length
+// around the SIMD block sizes, long identifiers and lines, comments up to
+// the end of the input, and the odd byte that starts no token. size takes
+// a K or M suffix; each seed gives the same output on every platform.
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+
+namespace {
+
+std::mt19937 rng;
+
+uint32_t pick(uint32_t n) {
+    return rng() % n;
+}
+
+const char* const WORDS[] = {
+    "var", "type", "routine", "print", "if", "else", "while", "for", "in", "reverse", "return",
+    "is", "end", "loop", "then", "record", "array", "size", "true", "false", "and", "or", "xor",
+    "not", "integer", "real", "boolean",
+};
+
+const char* const PUNCTUATION[] = {
+    ":=", ":", ",", ";", "(", ")", "[", "]", "..", "=>", ".", "<=", ">=", "<", ">", "=", "/=",
+    "%", "+", "-", "*", "/",
+};
+
+// Bytes that start no token
+const char* const STRAY[] = { "#", "$", "@", "!", "?", "{", "}", "~", "^", "&", "|", "\"", "'", "\x80", "\xff" };
+
+const char IDENT_CHARS[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ_0123456789";
+
+template<size_t N>
+const char* any(const char* const (&table)[N]) {
+    return table[pick(N)];
+}
+
+std::string identifier() {
+    std::string s(1, IDENT_CHARS[pick(53)]); // letter or '_'
+    uint32_t length = pick(8) == 0 ? pick(80) : pick(10);
+    for (uint32_t i = 0; i < length; i++) s += IDENT_CHARS[pick(63)];
+    return s;
+}
+
+std::string digits() {
+    std::string s;
+    for (uint32_t n = 1 + (pick(10) == 0 ? pick(30) : pick(6)); n > 0; n--) s += static_cast<char>('0' + pick(10));
+    return s;
+}
+
+std::string whitespace() {
+    static const char SPACE[] = " \t\n\r";
+    uint32_t length = pick(4) == 0 ? pick(100) : 1 + pick(3);
+    std::string s;
+    for (uint32_t i = 0; i < length; i++) s += pick(5) == 0 ? SPACE[pick(4)] : ' ';
+    return s;
+}
+
+void fragment(std::string& out) {
+    switch (pick(12)) {
+    case 0: case 1: out += any(WORDS); break;
+    case 2: out += any(WORDS); out += pick(2) ? identifier() : digits(); break; // "ifx", "end2"
+    case 3: case 4: out += identifier(); break;
+    case 5:
+        switch (pick(5)) {
+        case 0: out += digits() + "." + digits(); break;
+        case 1: out += digits() + "."; break;
+        case 2: out += "." + digits(); break;
+        case 3: out += digits() + ".." + digits(); break;
+        default: out += digits(); break;
+        }
+        break;
+    case 6: case 7: out += any(PUNCTUATION); break;
+    case 8: out += whitespace(); break;
+    case 9:
+        out += "//";
+        for (uint32_t n = pick(60); n > 0; n--) out += static_cast<char>(' ' + pick(95));
+        if (pick(8)) out += '\n';
+        break;
+    case 10: out += '\n'; break;
+    default:
+        if (pick(20) == 0) out += any(STRAY);
+        else out += ' ';
+        break;
+    }
+    if (pick(3)) out += ' ';
+}
+
+uint64_t parseSize(const char* text) {
+    char* end;
+    uint64_t size = strtoull(text, &end, 10);
+    switch (*end) {
+    case 'K': case 'k': return size << 10;
+    case 'M': case 'm': return size << 20;
+    default: return size;
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc != 4) {
+        fprintf(stderr, "Usage: %s <seed> <size> <output_file>\n", argv[0]);
+        return 1;
+    }
+    rng.seed(static_cast<uint32_t>(strtoul(argv[1], nullptr, 10)));
+    uint64_t size = parseSize(argv[2]);
+
+    std::string text;
+    while (text.size() < size) fragment(text);
+
+    FILE* out = fopen(argv[3], "wb");
+    if (!out) {
+        fprintf(stderr, "Error: Cannot open output file '%s'\n", argv[3]);
+        return 1;
+    }
+    fwrite(text.data(), 1, text.size(), out);
+    fclose(out);
+    return 0;
+}
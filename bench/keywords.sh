@@ -0,0 +1,52 @@
+#!/bin/sh
+# Compares the two keyword layouts of lexer.l:
+#   hash     keywords matched by {ID} and classified by the perfect hash in
+#            keywords.h (the layout lexer.l uses)
+#   literal  one flex rule per keyword ahead of {ID}, regenerated from the
+#            KEYWORDS table by bench/literal_keywords.sh
+# and reports DFA table size and scan throughput for each.
+#
+# Usage: bench/keywords.sh <input_file> [runs]
+set -e
+
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+FLEX=${FLEX:-flex}
+CXX=${CXX:-g++}
+CXXFLAGS=${CXXFLAGS:--std=c++17 -O2 -pthread}
+
+if [ $# -lt 1 ]; then
+    echo "Usage: $0 <input_file> [runs]" >&2
+    exit 1
+fi
+INPUT=$1
+RUNS=${2:-5}
+
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+# Literal layout: a rule for every KEYWORDS entry, inserted before {ID}
+sh "$ROOT/bench/literal_keywords.sh" "$ROOT/lexer.l" "$WORK/literal.l"
+cp "$ROOT/lexer.l" "$WORK/hash.l"
+
+BYTES=$(wc -c < "$INPUT")
+printf '%-8s %12s %12s %10s\n' layout dfa_states table_bytes MB/s
+for layout in hash literal; do
+    $FLEX -v -o "$WORK/$layout.yy.cc" "$WORK/$layout.l" 2> "$WORK/$layout.stats"
+    $CXX $CXXFLAGS -I"$ROOT" -c "$WORK/$layout.yy.cc" -o "$WORK/$layout.o"
+    $CXX $CXXFLAGS "$WORK/$layout.o" -o "$WORK/$layout"
+
+    states=$(sed -n 's/^ *\([0-9]*\)\/[0-9]* DFA states.*/\1/p' "$WORK/$layout.stats")
+    tables=$(nm -S -t d "$WORK/$layout.o" | awk '$4 ~ /^_?yy_(accept|ec|meta|base|def|nxt|chk)$/ { sum += $2 } END { print sum + 0 }')
+
+    best=""
+    i=0
+    while [ $i -lt "$RUNS" ]; do
+        start=$(date +%s.%N)
+        "$WORK/$layout" --format=binary "$INPUT" "$WORK/out.tok" > /dev/null
+        end=$(date +%s.%N)
+        best=$(echo "$start $end $best" | awk '{ t = $2 - $1; if ($3 != "" && $3 < t) t = $3; print t }')
+        i=$((i + 1))
+    done
+    mbs=$(echo "$BYTES $best" | awk '{ printf "%.1f", $1 / 1e6 / $2 }')
+    printf '%-8s %12s %12s %10s\n' "$layout" "${states:-?}" "$tables" "$mbs"
+done
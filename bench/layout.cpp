@@ -0,0 +1,177 @@
+// Compares runtime layouts for an array of records in the interpreter.
+//
+// Usage: layout [records] [fields]     (default: 1000000 8)
+//
+// Each run builds an array of records with the given number of integer
+// fields and then sums field 0 of every record in a counted loop, in
+// three layouts:
+//   boxed     the array holds references to records allocated one by one
+//             (in scattered order, as a general-purpose heap would place them)
+//   flat      records stored inline, one after the other
+//   by-field  structure of arrays: all field 0 values, then all field 1, ...
+// For each it prints the time of the summing loop and, where perf events
+// are available, its cache misses ("-" otherwise):
+//
+//   <layout> <ms> <cache misses> <sum>
+//
+// Build: g++ -std=c++17 -O2 -I. bench/layout.cpp -o layout
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "../interpreter.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+enum class Layout { BOXED, FLAT, BY_FIELD };
+
+// Registers: 0 records, 1 array, 2 index, 3 limit, 4 ref, 5 value, 6 sum,
+// 7 scattered index, 8 scratch
+Program build(Layout layout, int32_t records, int32_t fields, bool sum) {
+    Program program;
+    Routine routine;
+    RoutineBuilder b(routine);
+    b.emit(Op::LOAD_INT, 0, 0, 0, records);
+    b.emit(Op::NEW_ARRAY, 1, 0, 0, layout == Layout::BOXED ? 1 : fields);
+
+    // for i in 1..records: element(scattered(i)).field0 = i
+    b.emit(Op::LOAD_INT, 2, 0, 0, 1);
+    b.emit(Op::MOVE, 3, 0);
+    size_t prep = b.emit(Op::FOR_PREP, 2);
+    size_t body = b.here();
+    b.emit(Op::LOAD_INT, 8, 0, 0, 7919);
+    b.emit(Op::MUL_I, 7, 2, 8);
+    b.emit(Op::MOD_I, 7, 7, 0);
+    b.emit(Op::LOAD_INT, 8, 0, 0, 1);
+    b.emit(Op::ADD_I, 7, 7, 8);
+    switch (layout) {
+    case Layout::BOXED:
+        b.emit(Op::NEW_RECORD, 5, 0, 0, fields);
+        b.emit(Op::STORE, 5, 2, 0, 0);
+        b.emit(Op::INDEX, 4, 1, 7, 1);
+        b.emit(Op::STORE, 4, 5, 0, 0);
+        break;
+    case Layout::FLAT:
+        b.emit(Op::INDEX, 4, 1, 7, fields);
+        b.emit(Op::STORE, 4, 2, 0, 0);
+        break;
+    case Layout::BY_FIELD:
+        b.emit(Op::INDEX_SOA, 4, 1, 7, 0);
+        b.emit(Op::STORE, 4, 2, 0, 0);
+        break;
+    }
+    b.patch(b.emit(Op::FOR_LOOP, 2), body);
+    b.patch(prep, b.here());
+
+    // sum = 0; for i in 1..records: sum += element(i).field0
+    b.emit(Op::LOAD_INT, 6, 0, 0, 0);
+    if (sum) {
+        b.emit(Op::LOAD_INT, 2, 0, 0, 1);
+        prep = b.emit(Op::FOR_PREP, 2);
+        body = b.here();
+        switch (layout) {
+        case Layout::BOXED:
+            b.emit(Op::INDEX, 4, 1, 2, 1);
+            b.emit(Op::LOAD, 4, 4, 0, 0);
+            break;
+        case Layout::FLAT:
+            b.emit(Op::INDEX, 4, 1, 2, fields);
+            break;
+        case Layout::BY_FIELD:
+            b.emit(Op::INDEX_SOA, 4, 1, 2, 0);
+            break;
+        }
+        b.emit(Op::LOAD, 5, 4, 0, 0);
+        b.emit(Op::ADD_I, 6, 6, 5);
+        b.patch(b.emit(Op::FOR_LOOP, 2), body);
+        b.patch(prep, b.here());
+    }
+    b.emit(Op::RETURN, 6);
+    program.routines.push_back(routine);
+    return program;
+}
+
+// Hardware cache misses of this thread, or -1 without perf events
+class MissCounter {
+public:
+    MissCounter() {
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof attr);
+        attr.size = sizeof attr;
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_CACHE_MISSES;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+
+    ~MissCounter() {
+        if (fd >= 0) close(fd);
+    }
+
+    long long read() const {
+        long long count;
+        if (fd < 0 || ::read(fd, &count, sizeof count) != sizeof count) return -1;
+        return count;
+    }
+
+private:
+    int fd;
+};
+
+struct Run {
+    double ms;
+    long long misses;
+    int64_t sum;
+};
+
+Run measure(const Program& program, const MissCounter& counter) {
+    std::ostringstream out;
+    Interpreter interpreter(program, out);
+    Value result;
+    long long before = counter.read();
+    Clock::time_point start = Clock::now();
+    if (!interpreter.run(0, nullptr, result)) {
+        fprintf(stderr, "layout: %s\n", interpreter.error().message.c_str());
+        exit(1);
+    }
+    double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    long long after = counter.read();
+    return Run{ ms, before < 0 ? -1 : after - before, result.i };
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    int32_t records = argc > 1 ? atoi(argv[1]) : 1000000;
+    int32_t fields = argc > 2 ? atoi(argv[2]) : 8;
+    if (records <= 0 || fields <= 0 || records % 7919 == 0) {
+        fprintf(stderr, "usage: layout [records] [fields]  (records not a multiple of 7919)\n");
+        return 2;
+    }
+
+    MissCounter counter;
+    const char* names[] = { "boxed", "flat", "by-field" };
+    const Layout layouts[] = { Layout::BOXED, Layout::FLAT, Layout::BY_FIELD };
+    for (int i = 0; i < 3; i++) {
+        // The summing loop alone: the whole run minus the setup
+        Run setup = measure(build(layouts[i], records, fields, false), counter);
+        Run full = measure(build(layouts[i], records, fields, true), counter);
+        long long misses = full.misses < 0 ? -1 : full.misses - setup.misses;
+        char missText[32] = "-";
+        if (misses >= 0) snprintf(missText, sizeof missText, "%lld", misses);
+        printf("%-9s %8.1f %12s %lld\n", names[i], full.ms - setup.ms, missText,
+               static_cast<long long>(full.sum));
+    }
+    return 0;
+}
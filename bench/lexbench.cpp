@@ -0,0 +1,178 @@
+// Measures lexer throughput on one input.
+//
+// Usage: lexbench api <input_file> [jobs]
+//        lexbench count <input_file>
+//        lexbench exec <input_file> <lexer> [lexer options...]
+//        lexbench startup <input_file> <runs> <lexer> [lexer options...]
+//
+// "api" maps the input and calls tokenize()/tokenizeParallel() in process.
+// "count" calls countTokens(), which scans without storing any tokens.
+// "exec" runs the lexer binary with --format=binary, then decodes its output
+// to count the tokens. Both print one line:
+//
+//   <MB/s> <tokens/s> <peak RSS in MB> <tokens>
+//
+// "startup" runs the lexer binary <runs> times on a (small) input and
+// prints the wall time per run, fork and exec included:
+//
+//   <mean us> <min us>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "../lexer.h"
+#include "../mapped_file.h"
+#include "../token_stream.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+void report(uint64_t bytes, uint64_t tokens, double seconds, long peakKb) {
+    printf("%.1f %.0f %.1f %llu\n", bytes / 1e6 / seconds, tokens / seconds, peakKb / 1024.0,
+           static_cast<unsigned long long>(tokens));
+}
+
+int runApi(const char* input, unsigned jobs) {
+    MappedFile file;
+    if (!file.open(input)) {
+        fprintf(stderr, "Error: Cannot open input file '%s'\n", input);
+        return 1;
+    }
+    TokenBuffer tokens;
+    Clock::time_point start = Clock::now();
+    if (jobs > 1) {
+        tokenizeParallel(file.data(), file.size(), tokens, jobs);
+    } else {
+        tokenize(file.data(), file.size(), tokens);
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    report(file.size(), tokens.size(), seconds, usage.ru_maxrss);
+    return 0;
+}
+
+int runCount(const char* input) {
+    MappedFile file;
+    if (!file.open(input)) {
+        fprintf(stderr, "Error: Cannot open input file '%s'\n", input);
+        return 1;
+    }
+    Clock::time_point start = Clock::now();
+    uint64_t tokens = countTokens(file.data(), file.size());
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    report(file.size(), tokens, seconds, usage.ru_maxrss);
+    return 0;
+}
+
+// Runs the lexer with args (null-terminated) and returns its wall time,
+// or a negative value if it failed.
+double spawn(std::vector<char*>& args, struct rusage& usage) {
+    Clock::time_point start = Clock::now();
+    pid_t pid = fork();
+    if (pid == 0) {
+        freopen("/dev/null", "w", stdout);
+        execv(args[0], args.data());
+        _exit(127);
+    }
+    int status;
+    wait4(pid, &status, 0, &usage);
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        fprintf(stderr, "Error: '%s' failed\n", args[0]);
+        return -1;
+    }
+    return seconds;
+}
+
+int runExec(const char* input, char** lexer, int lexerArgs) {
+    std::string output = std::string("/tmp/lexbench.") + std::to_string(getpid()) + ".tok";
+    std::vector<char*> args(lexer, lexer + lexerArgs);
+    std::string format = "--format=binary";
+    args.push_back(&format[0]);
+    args.push_back(const_cast<char*>(input));
+    args.push_back(&output[0]);
+    args.push_back(nullptr);
+
+    struct rusage usage;
+    double seconds = spawn(args, usage);
+    if (seconds < 0) {
+        unlink(output.c_str());
+        return 1;
+    }
+
+    uint64_t tokens = 0;
+    std::ifstream in(output, std::ios::binary);
+    BinaryTokenReader reader(in);
+    TokenKind kind;
+    uint64_t offset, length;
+    while (reader.next(kind, offset, length)) tokens++;
+    in.close();
+    unlink(output.c_str());
+
+    std::ifstream source(input, std::ios::binary | std::ios::ate);
+    report(static_cast<uint64_t>(source.tellg()), tokens, seconds, usage.ru_maxrss);
+    return 0;
+}
+
+int runStartup(const char* input, int runs, char** lexer, int lexerArgs) {
+    std::string output = std::string("/tmp/lexbench.") + std::to_string(getpid()) + ".tok";
+    std::vector<char*> args(lexer, lexer + lexerArgs);
+    std::string format = "--format=binary";
+    args.push_back(&format[0]);
+    args.push_back(const_cast<char*>(input));
+    args.push_back(&output[0]);
+    args.push_back(nullptr);
+
+    double total = 0;
+    double fastest = 0;
+    for (int i = 0; i < runs; i++) {
+        struct rusage usage;
+        double seconds = spawn(args, usage);
+        if (seconds < 0) {
+            unlink(output.c_str());
+            return 1;
+        }
+        total += seconds;
+        if (i == 0 || seconds < fastest) fastest = seconds;
+    }
+    unlink(output.c_str());
+    printf("%.0f %.0f\n", total / runs * 1e6, fastest * 1e6);
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    std::string mode = argc > 2 ? argv[1] : "";
+    if (mode == "api" && argc <= 4) {
+        return runApi(argv[2], argc == 4 ? static_cast<unsigned>(atoi(argv[3])) : 1);
+    }
+    if (mode == "count" && argc == 3) {
+        return runCount(argv[2]);
+    }
+    if (mode == "exec" && argc >= 4) {
+        return runExec(argv[2], argv + 3, argc - 3);
+    }
+    if (mode == "startup" && argc >= 5 && atoi(argv[3]) > 0) {
+        return runStartup(argv[2], atoi(argv[3]), argv + 4, argc - 4);
+    }
+    fprintf(stderr, "Usage: %s api <input_file> [jobs]\n", argv[0]);
+    fprintf(stderr, "       %s count <input_file>\n", argv[0]);
+    fprintf(stderr, "       %s exec <input_file> <lexer> [lexer options...]\n", argv[0]);
+    fprintf(stderr, "       %s startup <input_file> <runs> <lexer> [lexer options...]\n", argv[0]);
+    return 1;
+}
@@ -0,0 +1,19 @@
+#!/bin/sh
+# Copies the flex spec <in.l> to <out.l> with one literal rule for every
+# entry of the KEYWORDS table in keywords.h, inserted ahead of its {ID}
+# rule. The rules return emit(kind), like the other rules of lexer.l.
+#
+# Usage: bench/literal_keywords.sh <in.l> <out.l>
+set -e
+
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+
+if [ $# -ne 2 ]; then
+    echo "Usage: $0 <in.l> <out.l>" >&2
+    exit 1
+fi
+
+sed -n 's/^ *{ "\([a-z]*\)", [0-9]*, TokenKind::\([A-Z_]*\) },$/"\1"    { return emit(TokenKind::\2); }/p' \
+    "$ROOT/keywords.h" > "$2.rules"
+awk -v rules="$2.rules" '/^\{ID\}/ { while ((getline line < rules) > 0) print line } { print }' "$1" > "$2"
+rm -f "$2.rules"
@@ -0,0 +1,64 @@
+#!/bin/sh
+# Lexer throughput benchmarks over generated corpora.
+#
+# Usage: bench/run.sh [size...]        (default: 1M 100M 1G)
+#
+# Builds the lexer and the bench tools into bench/build, generates one
+# corpus per mix and size into bench/corpus (kept between runs, since the
+# generator is deterministic), then times the lexer binary and the
+# in-process API on each. Environment:
+#   FLEX, CXX, CXXFLAGS  tools and flags used for the build
+#   MIXES                corpus mixes to run (default: all five)
+#   JOBS                 thread count for the extra -j rows (default: nproc)
+#   RUNS                 repetitions per row, best one reported (default: 3)
+set -e
+
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+BUILD=$ROOT/bench/build
+CORPUS=$ROOT/bench/corpus
+FLEX=${FLEX:-flex}
+CXX=${CXX:-g++}
+CXXFLAGS=${CXXFLAGS:--std=c++17 -O2 -pthread}
+MIXES=${MIXES:-keywords identifiers numbers comments whitespace}
+JOBS=${JOBS:-$(nproc 2>/dev/null || echo 1)}
+RUNS=${RUNS:-3}
+SIZES=${*:-1M 100M 1G}
+
+mkdir -p "$BUILD" "$CORPUS"
+$FLEX -o "$BUILD/lex.yy.cc" "$ROOT/lexer.l"
+$CXX $CXXFLAGS -I"$ROOT" "$BUILD/lex.yy.cc" -o "$BUILD/lexer"
+$CXX $CXXFLAGS -I"$ROOT" -DLEXER_NO_MAIN "$BUILD/lex.yy.cc" "$ROOT/bench/lexbench.cpp" -o "$BUILD/lexbench"
+$CXX $CXXFLAGS "$ROOT/bench/gen_corpus.cpp" -o "$BUILD/gen_corpus"
+
+# Best of RUNS runs by MB/s
+best() {
+    i=0
+    result=""
+    while [ $i -lt "$RUNS" ]; do
+        line=$("$@")
+        result=$(printf '%s\n%s\n' "$result" "$line" | sort -n -r | head -n 1)
+        i=$((i + 1))
+    done
+    echo "$result"
+}
+
+row() {
+    printf '%-12s %6s %-12s %10s %14s %10s %12s\n' "$@"
+}
+
+row mix size mode MB/s tokens/s peak_MB tokens
+for size in $SIZES; do
+    for mix in $MIXES; do
+        input=$CORPUS/$mix-$size.i
+        [ -f "$input" ] || "$BUILD/gen_corpus" "$mix" "$size" "$input"
+
+        row "$mix" "$size" lexer $(best "$BUILD/lexbench" exec "$input" "$BUILD/lexer")
+        row "$mix" "$size" lexer-mmap $(best "$BUILD/lexbench" exec "$input" "$BUILD/lexer" --mmap)
+        row "$mix" "$size" api $(best "$BUILD/lexbench" api "$input")
+        row "$mix" "$size" count $(best "$BUILD/lexbench" count "$input")
+        if [ "$JOBS" -gt 1 ]; then
+            row "$mix" "$size" "lexer-j$JOBS" $(best "$BUILD/lexbench" exec "$input" "$BUILD/lexer" -j "$JOBS")
+            row "$mix" "$size" "api-j$JOBS" $(best "$BUILD/lexbench" api "$input" "$JOBS")
+        fi
+    done
+done
@@ -0,0 +1,52 @@
+#!/bin/sh
+# Compares lexer builds for small per-file invocations:
+#   dynamic       flex's default compressed tables (-Cem), dynamically linked
+#   static-fast   full tables (-Cf; flex rejects -CF with %option c++),
+#                 statically linked
+#   static-small  compressed tables (-Cem), statically linked
+# and reports, for each, the DFA table size, the binary size, the time per
+# run on a one-line input (process startup included) and throughput on a
+# larger input.
+#
+# Usage: bench/startup.sh [input_file] [runs]     (default: generated 10M corpus, 200 runs)
+set -e
+
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+BUILD=$ROOT/bench/build
+FLEX=${FLEX:-flex}
+CXX=${CXX:-g++}
+CXXFLAGS=${CXXFLAGS:--std=c++17 -O2 -pthread}
+RUNS=${2:-200}
+
+mkdir -p "$BUILD"
+$FLEX -o "$BUILD/lex.yy.cc" "$ROOT/lexer.l"
+$CXX $CXXFLAGS -I"$ROOT" -DLEXER_NO_MAIN "$BUILD/lex.yy.cc" "$ROOT/bench/lexbench.cpp" -o "$BUILD/lexbench"
+INPUT=$1
+if [ -z "$INPUT" ]; then
+    $CXX $CXXFLAGS "$ROOT/bench/gen_corpus.cpp" -o "$BUILD/gen_corpus"
+    mkdir -p "$ROOT/bench/corpus"
+    INPUT=$ROOT/bench/corpus/keywords-10M.i
+    [ -f "$INPUT" ] || "$BUILD/gen_corpus" keywords 10M "$INPUT"
+fi
+SMALL=$BUILD/startup.i
+echo "var x : integer is 1;" > "$SMALL"
+
+printf '%-13s %12s %12s %10s %10s %10s\n' build table_bytes binary_bytes mean_us min_us MB/s
+for build in dynamic static-fast static-small; do
+    case $build in
+        dynamic) tables=-Cem link="" ;;
+        static-fast) tables=-Cf link=-static ;;
+        static-small) tables=-Cem link=-static ;;
+    esac
+    $FLEX $tables -o "$BUILD/$build.yy.cc" "$ROOT/lexer.l"
+    $CXX $CXXFLAGS -I"$ROOT" -c "$BUILD/$build.yy.cc" -o "$BUILD/$build.o"
+    # shellcheck disable=SC2086
+    $CXX $CXXFLAGS $link "$BUILD/$build.o" -o "$BUILD/lexer-$build"
+
+    table_bytes=$(nm -S -t d "$BUILD/$build.o" | awk '$4 ~ /^_?yy_(accept|ec|meta|base|def|nxt|chk|transition)$/ { sum += $2 } END { print sum + 0 }')
+    binary_bytes=$(wc -c < "$BUILD/lexer-$build")
+    startup=$("$BUILD/lexbench" startup "$SMALL" "$RUNS" "$BUILD/lexer-$build")
+    mbs=$("$BUILD/lexbench" exec "$INPUT" "$BUILD/lexer-$build" | cut -d' ' -f1)
+    # shellcheck disable=SC2086
+    printf '%-13s %12s %12s %10s %10s %10s\n' "$build" "$table_bytes" "$binary_bytes" $startup "$mbs"
+done
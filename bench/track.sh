@@ -0,0 +1,52 @@
+#!/bin/sh
+# Records benchmark throughput per commit and flags regressions.
+#
+# Usage: bench/track.sh [size...]        (default: 100M)
+#
+# Runs bench/run.sh with the given sizes and appends each row, tagged with
+# the current commit, to HISTORY. Every row's MB/s is then compared with
+# the same mix, size and mode at the most recent other commit in HISTORY.
+# Rows that are slower by more than THRESHOLD percent are listed, and the
+# exit status is 1. A commit with uncommitted changes is recorded as
+# <commit>-dirty. Environment (plus everything bench/run.sh takes):
+#   HISTORY    tab-separated history file (default: bench/history.tsv)
+#   THRESHOLD  allowed slowdown in percent (default: 5)
+set -e
+
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+HISTORY=${HISTORY:-$ROOT/bench/history.tsv}
+THRESHOLD=${THRESHOLD:-5}
+SIZES=${*:-100M}
+
+commit=$(git -C "$ROOT" rev-parse --short HEAD)
+git -C "$ROOT" diff --quiet HEAD -- || commit="$commit-dirty"
+date=$(date -u +%Y-%m-%dT%H:%M:%SZ)
+
+RESULTS=$(mktemp)
+trap 'rm -f "$RESULTS"' EXIT
+# shellcheck disable=SC2086
+"$ROOT/bench/run.sh" $SIZES | tee /dev/stderr | awk 'NR > 1 { print $1 "\t" $2 "\t" $3 "\t" $4 "\t" $5 }' > "$RESULTS"
+
+[ -f "$HISTORY" ] || printf 'commit\tdate\tmix\tsize\tmode\tMB/s\ttokens/s\n' > "$HISTORY"
+
+status=0
+awk -F '\t' -v commit="$commit" -v threshold="$THRESHOLD" '
+    FNR == NR {
+        if (FNR > 1 && $1 != commit) { base[$3 FS $4 FS $5] = $6; baseCommit[$3 FS $4 FS $5] = $1 }
+        next
+    }
+    {
+        key = $1 FS $2 FS $3
+        if (!(key in base) || base[key] <= 0) next
+        change = ($4 - base[key]) * 100 / base[key]
+        if (change < -threshold) {
+            printf "regression: %s %s %s %.1f MB/s, was %.1f at %s (%.1f%%)\n", \
+                $1, $2, $3, $4, base[key], baseCommit[key], change
+            failed = 1
+        }
+    }
+    END { exit failed }
+' "$HISTORY" "$RESULTS" >&2 || status=1
+
+awk -v commit="$commit" -v date="$date" '{ print commit "\t" date "\t" $0 }' "$RESULTS" >> "$HISTORY"
+exit $status
@@ -0,0 +1,140 @@
+#ifndef BYTECODE_H
+#define BYTECODE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Register-based bytecode for I programs. Each routine has a window of up
+// to 256 registers holding 64-bit values: an integer, a real, a boolean
+// (0 or 1), or a reference into the interpreter's heap. Instructions are
+// typed (ADD_I, ADD_R, ...), so the interpreter never checks value types.
+//
+// Records and arrays are flat runs of heap slots. A record's fields are
+// consecutive slots; an array is a length slot followed by its elements,
+// each of them elementSlots wide. An array of records therefore stores
+// the records inline, one after the other, with no per-element boxing.
+// The code generator may instead lay an array of records out by field
+// (structure of arrays): the length slot, then every element's field 0,
+// then every field 1, and so on. INDEX_SOA addresses one field of one
+// element in that layout, so a loop that reads one field of each record
+// walks consecutive slots.
+// Array indices run from 1, as in the language.
+
+// X(name, operands): a is the destination register unless noted, b and c
+// are source registers, imm is a signed immediate.
+#define BYTECODE_OPS(X)                                                        \
+    X(MOVE,      "a = b")                                                      \
+    X(LOAD_INT,  "a = imm")                                                    \
+    X(LOAD_CONST,"a = constants[imm]")                                         \
+    X(ADD_I, "a = b + c") X(SUB_I, "a = b - c") X(MUL_I, "a = b * c")          \
+    X(DIV_I, "a = b / c") X(MOD_I, "a = b % c") X(NEG_I, "a = -b")             \
+    X(ADD_R, "a = b + c") X(SUB_R, "a = b - c") X(MUL_R, "a = b * c")          \
+    X(DIV_R, "a = b / c") X(NEG_R, "a = -b")                                   \
+    X(INT_TO_REAL, "a = real(b)")                                              \
+    X(REAL_TO_INT, "a = integer(b), rounded to nearest")                       \
+    X(EQ_I, "a = b = c") X(NE_I, "a = b /= c")                                 \
+    X(LT_I, "a = b < c") X(LE_I, "a = b <= c")                                 \
+    X(EQ_R, "a = b = c") X(NE_R, "a = b /= c")                                 \
+    X(LT_R, "a = b < c") X(LE_R, "a = b <= c")                                 \
+    X(AND, "a = b and c") X(OR, "a = b or c") X(XOR, "a = b xor c")            \
+    X(NOT, "a = not b")                                                        \
+    X(JUMP,          "pc += imm")                                              \
+    X(JUMP_IF_FALSE, "if not a: pc += imm")                                    \
+    X(JUMP_IF_TRUE,  "if a: pc += imm")                                        \
+    X(FOR_PREP,      "a index, a+1 limit: if a > a+1: pc += imm")              \
+    X(FOR_LOOP,      "if a < a+1: a += 1, pc += imm")                          \
+    X(FOR_PREP_REV,  "a index, a+1 limit: if a < a+1: pc += imm")              \
+    X(FOR_LOOP_REV,  "if a > a+1: a -= 1, pc += imm")                          \
+    X(NEW_RECORD, "a = new record of imm slots")                               \
+    X(NEW_ARRAY,  "a = new array of b elements, imm slots each")               \
+    X(LENGTH,     "a = length of array b")                                     \
+    X(INDEX,      "a = ref to element c of array b, imm slots each; checked")  \
+    X(INDEX_UNCHECKED, "same as INDEX, index known to be in range")            \
+    X(INDEX_SOA,  "a = ref to field imm of element c of by-field array b")     \
+    X(INDEX_SOA_UNCHECKED, "same as INDEX_SOA, index known to be in range")    \
+    X(LOAD,       "a = heap[b + imm]")                                         \
+    X(STORE,      "heap[a + imm] = b")                                         \
+    X(COPY,       "heap[a ..] = heap[b ..], imm slots")                        \
+    X(CALL,       "a = routines[imm](a, a+1, ...)")                            \
+    X(RETURN,     "return a")                                                  \
+    X(RETURN_NONE,"return")                                                    \
+    X(PRINT_I, "print a") X(PRINT_R, "print a") X(PRINT_B, "print a")
+
+enum class Op : uint8_t {
+#define BYTECODE_ENUM(name, operands) name,
+    BYTECODE_OPS(BYTECODE_ENUM)
+#undef BYTECODE_ENUM
+    COUNT
+};
+
+struct Instruction {
+    Op op;
+    uint8_t a;
+    uint8_t b;
+    uint8_t c;
+    int32_t imm;
+};
+
+union Value {
+    int64_t i;
+    double r;
+};
+
+struct Routine {
+    std::string name;
+    uint32_t params = 0;    // passed in registers 0 .. params - 1
+    uint32_t registers = 0; // size of the register window
+    std::vector<Instruction> code;
+};
+
+struct Program {
+    std::vector<Routine> routines;
+    std::vector<Value> constants;
+};
+
+// Appends instructions to a routine and patches forward jumps, for the
+// code generator.
+class RoutineBuilder {
+public:
+    explicit RoutineBuilder(Routine& routine) : routine(routine) {}
+
+    size_t emit(Op op, uint8_t a = 0, uint8_t b = 0, uint8_t c = 0, int32_t imm = 0) {
+        routine.code.push_back(Instruction{ op, a, b, c, imm });
+        uint32_t used = std::max<uint32_t>({ a, b, c }) + 1u;
+        if (op == Op::FOR_PREP || op == Op::FOR_PREP_REV) used = a + 2u;
+        if (used > routine.registers) routine.registers = used;
+        return routine.code.size() - 1;
+    }
+
+    // Index of the next instruction, as a jump target
+    size_t here() const { return routine.code.size(); }
+
+    // Points the jump at index to target. Offsets count from the
+    // instruction after the jump.
+    void patch(size_t index, size_t target) {
+        routine.code[index].imm = static_cast<int32_t>(target) - static_cast<int32_t>(index) - 1;
+    }
+
+    size_t jumpTo(Op op, uint8_t a, size_t target) {
+        size_t index = emit(op, a);
+        patch(index, target);
+        return index;
+    }
+
+private:
+    Routine& routine;
+};
+
+inline const char* opName(Op op) {
+    static const char* const names[] = {
+#define BYTECODE_NAME(name, operands) #name,
+        BYTECODE_OPS(BYTECODE_NAME)
+#undef BYTECODE_NAME
+    };
+    return names[static_cast<uint8_t>(op)];
+}
+
+#endif // BYTECODE_H
@@ -0,0 +1,307 @@
+#ifndef INTERPRETER_H
+#define INTERPRETER_H
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "bytecode.h"
+
+struct RuntimeError {
+    uint32_t routine;
+    uint32_t pc;     // index of the failing instruction
+    std::string message;
+};
+
+// Native code for one routine, made by a NativeCompiler. run() executes
+// the routine from instruction pc on its register window and the heap. It
+// returns -1 once the routine returns, with the result in registers[0],
+// or the index of an instruction whose bounds check failed.
+class NativeCode {
+public:
+    virtual ~NativeCode() {}
+    virtual int64_t run(Value* registers, Value* heap, uint32_t pc) = 0;
+};
+
+class NativeCompiler {
+public:
+    virtual ~NativeCompiler() {}
+    // nullptr if the routine uses instructions the compiler does not handle
+    virtual std::unique_ptr<NativeCode> compile(const Program& program, uint32_t routine) = 0;
+};
+
+// Runs bytecode from bytecode.h. Dispatch is a computed goto per
+// instruction, so each handler jumps straight to the next one and the
+// branch predictor sees one indirect jump per opcode instead of a single
+// shared one. Compilers without labels as values, or builds with
+// -DINTERPRETER_SWITCH_DISPATCH, use a switch instead.
+//
+// Runtime errors (division by zero, an index out of range, a negative
+// array size) stop the program; run() then returns false and error()
+// says where.
+//
+// With setTierUp() the interpreter counts calls and taken backward jumps
+// per routine. A routine whose count reaches the threshold is compiled to
+// native code, which then runs its later calls. A hot loop moves to native
+// code at its next iteration, without waiting for the routine to return.
+class Interpreter {
+public:
+    Interpreter(const Program& program, std::ostream& out)
+        : program(program), out(out), compiler(nullptr), tierThreshold(UINT32_MAX),
+          hotness(program.routines.size(), 0), native(program.routines.size()) {}
+
+    void setTierUp(NativeCompiler* compiler, uint32_t threshold = 1000) {
+        this->compiler = compiler;
+        tierThreshold = threshold;
+    }
+
+    // Routines that run as native code
+    size_t nativeRoutines() const {
+        size_t count = 0;
+        for (const std::unique_ptr<NativeCode>& code : native) count += code != nullptr;
+        return count;
+    }
+
+    // Calls routine with its parameters in args. result is the returned
+    // value for a routine that returns one.
+    bool run(uint32_t routine, const Value* args, Value& result) {
+        const Routine& entry = program.routines[routine];
+        stack.assign(entry.registers ? entry.registers : 1, Value{ 0 });
+        for (uint32_t i = 0; i < entry.params; i++) stack[i] = args[i];
+        heap.assign(1, Value{ 0 }); // reference 0 is never handed out
+        frames.clear();
+        bool ok = execute(routine);
+        result = stack[0];
+        return ok;
+    }
+
+    const RuntimeError& error() const { return lastError; }
+
+    // Heap slots in use, for tests and statistics
+    size_t heapSlots() const { return heap.size(); }
+
+private:
+    struct Frame {
+        uint32_t routine;
+        const Instruction* returnPc;
+        size_t base;
+    };
+
+    size_t allocate(size_t slots) {
+        size_t ref = heap.size();
+        heap.resize(ref + slots, Value{ 0 });
+        return ref;
+    }
+
+    NativeCode* compileHot(uint32_t routine) {
+        if (!compiler) return nullptr;
+        if (!native[routine]) native[routine] = compiler->compile(program, routine);
+        return native[routine].get();
+    }
+
+    bool execute(uint32_t routine);
+
+    const Program& program;
+    std::ostream& out;
+    NativeCompiler* compiler;
+    uint32_t tierThreshold;
+    std::vector<uint32_t> hotness; // calls and backward jumps, per routine
+    std::vector<std::unique_ptr<NativeCode>> native;
+    std::vector<Value> stack;
+    std::vector<Value> heap;
+    std::vector<Frame> frames;
+    RuntimeError lastError;
+};
+
+inline bool Interpreter::execute(uint32_t routine) {
+    const Instruction* code = program.routines[routine].code.data();
+    const Instruction* pc = code;
+    const Instruction* ins;
+    size_t base = 0;
+    Value* R = stack.data();
+    uint32_t* heat = &hotness[routine];
+    NativeCode* compiled = native[routine].get();
+    int64_t status;
+    const char* failure;
+
+#define A R[ins->a]
+#define B R[ins->b]
+#define C R[ins->c]
+#define VM_BACK_EDGE() do { if (++*heat == tierThreshold) goto tierUp; } while (0)
+
+    if (compiled) goto runNative;
+
+#if defined(__GNUC__) && !defined(INTERPRETER_SWITCH_DISPATCH)
+    static void* const labels[] = {
+#define BYTECODE_LABEL(name, operands) &&op_##name,
+        BYTECODE_OPS(BYTECODE_LABEL)
+#undef BYTECODE_LABEL
+    };
+#define VM_CASE(name) op_##name:
+#define VM_NEXT() do { ins = pc++; goto *labels[static_cast<uint8_t>(ins->op)]; } while (0)
+    VM_NEXT();
+#else
+#define VM_CASE(name) case Op::name:
+#define VM_NEXT() goto dispatch
+dispatch:
+    ins = pc++;
+    switch (ins->op) {
+#endif
+
+    VM_CASE(MOVE) A = B; VM_NEXT();
+    VM_CASE(LOAD_INT) A.i = ins->imm; VM_NEXT();
+    VM_CASE(LOAD_CONST) A = program.constants[ins->imm]; VM_NEXT();
+
+    VM_CASE(ADD_I) A.i = static_cast<int64_t>(static_cast<uint64_t>(B.i) + static_cast<uint64_t>(C.i)); VM_NEXT();
+    VM_CASE(SUB_I) A.i = static_cast<int64_t>(static_cast<uint64_t>(B.i) - static_cast<uint64_t>(C.i)); VM_NEXT();
+    VM_CASE(MUL_I) A.i = static_cast<int64_t>(static_cast<uint64_t>(B.i) * static_cast<uint64_t>(C.i)); VM_NEXT();
+    VM_CASE(DIV_I)
+        if (C.i == 0) { failure = "division by zero"; goto fail; }
+        A.i = (B.i == INT64_MIN && C.i == -1) ? INT64_MIN : B.i / C.i;
+        VM_NEXT();
+    VM_CASE(MOD_I)
+        if (C.i == 0) { failure = "division by zero"; goto fail; }
+        A.i = C.i == -1 ? 0 : B.i % C.i;
+        VM_NEXT();
+    VM_CASE(NEG_I) A.i = static_cast<int64_t>(0 - static_cast<uint64_t>(B.i)); VM_NEXT();
+
+    VM_CASE(ADD_R) A.r = B.r + C.r; VM_NEXT();
+    VM_CASE(SUB_R) A.r = B.r - C.r; VM_NEXT();
+    VM_CASE(MUL_R) A.r = B.r * C.r; VM_NEXT();
+    VM_CASE(DIV_R) A.r = B.r / C.r; VM_NEXT();
+    VM_CASE(NEG_R) A.r = -B.r; VM_NEXT();
+    VM_CASE(INT_TO_REAL) A.r = static_cast<double>(B.i); VM_NEXT();
+    VM_CASE(REAL_TO_INT) A.i = std::llround(B.r); VM_NEXT();
+
+    VM_CASE(EQ_I) A.i = B.i == C.i; VM_NEXT();
+    VM_CASE(NE_I) A.i = B.i != C.i; VM_NEXT();
+    VM_CASE(LT_I) A.i = B.i < C.i; VM_NEXT();
+    VM_CASE(LE_I) A.i = B.i <= C.i; VM_NEXT();
+    VM_CASE(EQ_R) A.i = B.r == C.r; VM_NEXT();
+    VM_CASE(NE_R) A.i = B.r != C.r; VM_NEXT();
+    VM_CASE(LT_R) A.i = B.r < C.r; VM_NEXT();
+    VM_CASE(LE_R) A.i = B.r <= C.r; VM_NEXT();
+
+    VM_CASE(AND) A.i = B.i & C.i; VM_NEXT();
+    VM_CASE(OR) A.i = B.i | C.i; VM_NEXT();
+    VM_CASE(XOR) A.i = B.i ^ C.i; VM_NEXT();
+    VM_CASE(NOT) A.i = B.i ^ 1; VM_NEXT();
+
+    VM_CASE(JUMP)
+        pc += ins->imm;
+        if (ins->imm < 0) VM_BACK_EDGE();
+        VM_NEXT();
+    VM_CASE(JUMP_IF_FALSE)
+        if (!A.i) {
+            pc += ins->imm;
+            if (ins->imm < 0) VM_BACK_EDGE();
+        }
+        VM_NEXT();
+    VM_CASE(JUMP_IF_TRUE)
+        if (A.i) {
+            pc += ins->imm;
+            if (ins->imm < 0) VM_BACK_EDGE();
+        }
+        VM_NEXT();
+    VM_CASE(FOR_PREP) if (A.i > R[ins->a + 1].i) pc += ins->imm; VM_NEXT();
+    VM_CASE(FOR_LOOP) if (A.i < R[ins->a + 1].i) { A.i++; pc += ins->imm; VM_BACK_EDGE(); } VM_NEXT();
+    VM_CASE(FOR_PREP_REV) if (A.i < R[ins->a + 1].i) pc += ins->imm; VM_NEXT();
+    VM_CASE(FOR_LOOP_REV) if (A.i > R[ins->a + 1].i) { A.i--; pc += ins->imm; VM_BACK_EDGE(); } VM_NEXT();
+
+    VM_CASE(NEW_RECORD) A.i = static_cast<int64_t>(allocate(ins->imm)); VM_NEXT();
+    VM_CASE(NEW_ARRAY) {
+        if (B.i < 0) { failure = "negative array size"; goto fail; }
+        int64_t length = B.i;
+        size_t ref = allocate(1 + static_cast<size_t>(length) * ins->imm);
+        heap[ref].i = length;
+        A.i = static_cast<int64_t>(ref);
+        VM_NEXT();
+    }
+    VM_CASE(LENGTH) A.i = heap[B.i].i; VM_NEXT();
+    VM_CASE(INDEX)
+        if (C.i < 1 || C.i > heap[B.i].i) { failure = "array index out of range"; goto fail; }
+        A.i = B.i + 1 + (C.i - 1) * ins->imm;
+        VM_NEXT();
+    VM_CASE(INDEX_UNCHECKED) A.i = B.i + 1 + (C.i - 1) * ins->imm; VM_NEXT();
+    VM_CASE(INDEX_SOA)
+        if (C.i < 1 || C.i > heap[B.i].i) { failure = "array index out of range"; goto fail; }
+        A.i = B.i + 1 + ins->imm * heap[B.i].i + (C.i - 1);
+        VM_NEXT();
+    VM_CASE(INDEX_SOA_UNCHECKED) A.i = B.i + 1 + ins->imm * heap[B.i].i + (C.i - 1); VM_NEXT();
+    VM_CASE(LOAD) A = heap[B.i + ins->imm]; VM_NEXT();
+    VM_CASE(STORE) heap[A.i + ins->imm] = B; VM_NEXT();
+    VM_CASE(COPY)
+        std::copy(heap.begin() + B.i, heap.begin() + B.i + ins->imm, heap.begin() + A.i);
+        VM_NEXT();
+
+    VM_CASE(CALL) {
+        const Routine& callee = program.routines[ins->imm];
+        frames.push_back(Frame{ routine, pc, base });
+        routine = static_cast<uint32_t>(ins->imm);
+        base += ins->a;
+        if (stack.size() < base + callee.registers) stack.resize(base + callee.registers + 256);
+        R = stack.data() + base;
+        code = callee.code.data();
+        pc = code;
+        heat = &hotness[routine];
+        compiled = native[routine].get();
+        if (compiled || (++*heat == tierThreshold && (compiled = compileHot(routine)))) goto runNative;
+        VM_NEXT();
+    }
+    VM_CASE(RETURN)
+        R[0] = A;
+        goto leave;
+    VM_CASE(RETURN_NONE)
+    leave: {
+        if (frames.empty()) return true;
+        Frame frame = frames.back();
+        frames.pop_back();
+        routine = frame.routine;
+        code = program.routines[routine].code.data();
+        pc = frame.returnPc;
+        base = frame.base;
+        R = stack.data() + base;
+        heat = &hotness[routine];
+        VM_NEXT();
+    }
+
+    VM_CASE(PRINT_I) out << A.i << '\n'; VM_NEXT();
+    VM_CASE(PRINT_R) out << A.r << '\n'; VM_NEXT();
+    VM_CASE(PRINT_B) out << (A.i ? "true" : "false") << '\n'; VM_NEXT();
+
+#if !defined(__GNUC__) || defined(INTERPRETER_SWITCH_DISPATCH)
+    case Op::COUNT:
+        break;
+    }
+#endif
+
+    failure = "invalid instruction";
+    goto fail;
+
+tierUp:
+    compiled = compileHot(routine);
+    if (!compiled) VM_NEXT();
+runNative:
+    status = compiled->run(R, heap.data(), static_cast<uint32_t>(pc - code));
+    if (status < 0) goto leave;
+    ins = code + status;
+    failure = "array index out of range";
+    goto fail;
+
+#undef VM_CASE
+#undef VM_NEXT
+#undef VM_BACK_EDGE
+#undef A
+#undef B
+#undef C
+
+fail:
+    lastError = RuntimeError{ routine, static_cast<uint32_t>(ins - code), failure };
+    return false;
+}
+
+#endif // INTERPRETER_H
@@ -0,0 +1,316 @@
+#ifndef JIT_H
+#define JIT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <memory>
+#include <vector>
+
+#if defined(__x86_64__) && defined(__unix__)
+#include <sys/mman.h>
+#endif
+
+#include "bytecode.h"
+#include "interpreter.h"
+
+// Template JIT for the interpreter's tiered mode. Each instruction is
+// replaced by a fixed machine code sequence that works on the register
+// window in memory, the same way the interpreter does, minus the dispatch.
+// Only x86-64 is supported. Routines that allocate, call, copy, print, divide
+// or round stay in the interpreter, as do all routines on other targets.
+//
+// The generated function is entered as
+//     int64_t f(Value* registers, Value* heap, const void* start)
+// and the first instruction jumps to start, which is the code of the
+// bytecode instruction where execution resumes.
+class TemplateJit : public NativeCompiler {
+public:
+    std::unique_ptr<NativeCode> compile(const Program& program, uint32_t routine) override;
+};
+
+#if defined(__x86_64__) && defined(__unix__)
+
+namespace jit_detail {
+
+typedef int64_t (*Entry)(Value* registers, Value* heap, const void* start);
+
+class ExecutableCode : public NativeCode {
+public:
+    ExecutableCode(void* memory, size_t size, std::vector<uint32_t> offsets)
+        : memory(memory), size(size), offsets(std::move(offsets)) {}
+
+    ~ExecutableCode() override { munmap(memory, size); }
+
+    int64_t run(Value* registers, Value* heap, uint32_t pc) override {
+        Entry entry = reinterpret_cast<Entry>(memory);
+        return entry(registers, heap, static_cast<char*>(memory) + offsets[pc]);
+    }
+
+private:
+    void* memory;
+    size_t size;
+    std::vector<uint32_t> offsets; // code offset of each instruction
+};
+
+// rdi = registers, rsi = heap; rax, rcx, rdx, xmm0 and xmm1 are scratch
+class Assembler {
+public:
+    std::vector<uint8_t> code;
+
+    void emit(std::initializer_list<uint8_t> bytes) { code.insert(code.end(), bytes); }
+
+    void imm32(int64_t value) {
+        uint32_t bits = static_cast<uint32_t>(value);
+        for (int i = 0; i < 4; i++) code.push_back(static_cast<uint8_t>(bits >> (8 * i)));
+    }
+
+    void imm64(int64_t value) {
+        uint64_t bits = static_cast<uint64_t>(value);
+        for (int i = 0; i < 8; i++) code.push_back(static_cast<uint8_t>(bits >> (8 * i)));
+    }
+
+    void loadRax(uint32_t reg) { emit({ 0x48, 0x8B, 0x87 }); imm32(8 * reg); }  // mov rax, [rdi + 8 * reg]
+    void loadRcx(uint32_t reg) { emit({ 0x48, 0x8B, 0x8F }); imm32(8 * reg); }  // mov rcx, [rdi + 8 * reg]
+    void storeRax(uint32_t reg) { emit({ 0x48, 0x89, 0x87 }); imm32(8 * reg); } // mov [rdi + 8 * reg], rax
+    void loadXmm0(uint32_t reg) { emit({ 0xF2, 0x0F, 0x10, 0x87 }); imm32(8 * reg); }
+    void loadXmm1(uint32_t reg) { emit({ 0xF2, 0x0F, 0x10, 0x8F }); imm32(8 * reg); }
+    void storeXmm0(uint32_t reg) { emit({ 0xF2, 0x0F, 0x11, 0x87 }); imm32(8 * reg); }
+    void movRaxImm(int32_t value) { emit({ 0x48, 0xC7, 0xC0 }); imm32(value); }
+
+    // rax = 0 or 1 from condition code cc (setcc al; movzx eax, al)
+    void setRax(uint8_t cc) { emit({ 0x0F, cc, 0xC0, 0x0F, 0xB6, 0xC0 }); }
+
+    // Jump with a 32-bit offset to be patched, returns the offset's position
+    size_t jump(std::initializer_list<uint8_t> opcode) {
+        emit(opcode);
+        size_t at = code.size();
+        imm32(0);
+        return at;
+    }
+
+    void patch(size_t at, size_t target) {
+        int64_t offset = static_cast<int64_t>(target) - static_cast<int64_t>(at + 4);
+        memcpy(&code[at], &offset, 4);
+    }
+};
+
+// Condition codes for 0x0F 0x80+cc jumps and 0x0F 0x90+cc setcc
+const uint8_t CC_E = 0x4, CC_NE = 0x5, CC_L = 0xC, CC_GE = 0xD, CC_LE = 0xE, CC_G = 0xF;
+
+inline bool compilable(const Instruction& ins) {
+    switch (ins.op) {
+    case Op::NEW_RECORD: case Op::NEW_ARRAY: case Op::COPY: case Op::CALL:
+    case Op::DIV_I: case Op::MOD_I: case Op::REAL_TO_INT:
+    case Op::PRINT_I: case Op::PRINT_R: case Op::PRINT_B: case Op::COUNT:
+        return false;
+    case Op::LOAD: case Op::STORE: case Op::INDEX: case Op::INDEX_UNCHECKED:
+    case Op::INDEX_SOA: case Op::INDEX_SOA_UNCHECKED:
+        return ins.imm > -(1 << 27) && ins.imm < (1 << 27); // imm * 8 fits a disp32
+    default:
+        return true;
+    }
+}
+
+} // namespace jit_detail
+
+inline std::unique_ptr<NativeCode> TemplateJit::compile(const Program& program, uint32_t routine) {
+    using namespace jit_detail;
+    const std::vector<Instruction>& code = program.routines[routine].code;
+    for (const Instruction& ins : code) {
+        if (!compilable(ins)) return nullptr;
+    }
+
+    Assembler as;
+    std::vector<uint32_t> offsets(code.size() + 1);
+    std::vector<std::pair<size_t, size_t>> jumps;    // offset position, target instruction
+    std::vector<std::pair<size_t, uint32_t>> checks; // offset position, failing instruction
+    as.emit({ 0xFF, 0xE2 });                         // jmp rdx
+
+    for (size_t i = 0; i < code.size(); i++) {
+        const Instruction& ins = code[i];
+        offsets[i] = static_cast<uint32_t>(as.code.size());
+        size_t target = i + 1 + ins.imm;
+        switch (ins.op) {
+        case Op::MOVE: as.loadRax(ins.b); as.storeRax(ins.a); break;
+        case Op::LOAD_INT: as.movRaxImm(ins.imm); as.storeRax(ins.a); break;
+        case Op::LOAD_CONST:
+            as.emit({ 0x48, 0xB8 }); // mov rax, imm64
+            as.imm64(program.constants[ins.imm].i);
+            as.storeRax(ins.a);
+            break;
+
+        case Op::ADD_I: case Op::SUB_I: case Op::MUL_I: case Op::AND: case Op::OR: case Op::XOR:
+            as.loadRax(ins.b);
+            as.loadRcx(ins.c);
+            switch (ins.op) {
+            case Op::ADD_I: as.emit({ 0x48, 0x01, 0xC8 }); break;       // add rax, rcx
+            case Op::SUB_I: as.emit({ 0x48, 0x29, 0xC8 }); break;       // sub rax, rcx
+            case Op::MUL_I: as.emit({ 0x48, 0x0F, 0xAF, 0xC1 }); break; // imul rax, rcx
+            case Op::AND: as.emit({ 0x48, 0x21, 0xC8 }); break;
+            case Op::OR: as.emit({ 0x48, 0x09, 0xC8 }); break;
+            default: as.emit({ 0x48, 0x31, 0xC8 }); break;              // xor rax, rcx
+            }
+            as.storeRax(ins.a);
+            break;
+        case Op::NEG_I: as.loadRax(ins.b); as.emit({ 0x48, 0xF7, 0xD8 }); as.storeRax(ins.a); break;
+        case Op::NOT: as.loadRax(ins.b); as.emit({ 0x48, 0x83, 0xF0, 0x01 }); as.storeRax(ins.a); break;
+        case Op::EQ_I: case Op::NE_I: case Op::LT_I: case Op::LE_I:
+            as.loadRax(ins.b);
+            as.loadRcx(ins.c);
+            as.emit({ 0x48, 0x39, 0xC8 }); // cmp rax, rcx
+            as.setRax(0x90 + (ins.op == Op::EQ_I ? CC_E : ins.op == Op::NE_I ? CC_NE
+                              : ins.op == Op::LT_I ? CC_L : CC_LE));
+            as.storeRax(ins.a);
+            break;
+
+        case Op::ADD_R: case Op::SUB_R: case Op::MUL_R: case Op::DIV_R: {
+            uint8_t opcode = ins.op == Op::ADD_R ? 0x58 : ins.op == Op::SUB_R ? 0x5C
+                           : ins.op == Op::MUL_R ? 0x59 : 0x5E;
+            as.loadXmm0(ins.b);
+            as.loadXmm1(ins.c);
+            as.emit({ 0xF2, 0x0F, opcode, 0xC1 }); // addsd/subsd/mulsd/divsd xmm0, xmm1
+            as.storeXmm0(ins.a);
+            break;
+        }
+        case Op::NEG_R:
+            as.loadRax(ins.b);
+            as.emit({ 0x48, 0x0F, 0xBA, 0xF8, 0x3F }); // btc rax, 63
+            as.storeRax(ins.a);
+            break;
+        case Op::INT_TO_REAL:
+            as.loadRax(ins.b);
+            as.emit({ 0xF2, 0x48, 0x0F, 0x2A, 0xC0 }); // cvtsi2sd xmm0, rax
+            as.storeXmm0(ins.a);
+            break;
+        // Comparisons with NaN are false, and NaN /= x is true
+        case Op::EQ_R: case Op::NE_R:
+            as.loadXmm0(ins.b);
+            as.loadXmm1(ins.c);
+            as.emit({ 0x66, 0x0F, 0x2E, 0xC1 }); // ucomisd xmm0, xmm1
+            if (ins.op == Op::EQ_R) as.emit({ 0x0F, 0x94, 0xC0, 0x0F, 0x9B, 0xC1, 0x20, 0xC8 }); // sete, setnp, and
+            else as.emit({ 0x0F, 0x95, 0xC0, 0x0F, 0x9A, 0xC1, 0x08, 0xC8 });                   // setne, setp, or
+            as.emit({ 0x0F, 0xB6, 0xC0 });
+            as.storeRax(ins.a);
+            break;
+        case Op::LT_R: case Op::LE_R:
+            as.loadXmm0(ins.b);
+            as.loadXmm1(ins.c);
+            as.emit({ 0x66, 0x0F, 0x2E, 0xC8 });              // ucomisd xmm1, xmm0
+            as.setRax(ins.op == Op::LT_R ? 0x97 : 0x93);     // seta / setae
+            as.storeRax(ins.a);
+            break;
+
+        case Op::JUMP: jumps.emplace_back(as.jump({ 0xE9 }), target); break;
+        case Op::JUMP_IF_FALSE: case Op::JUMP_IF_TRUE:
+            as.loadRax(ins.a);
+            as.emit({ 0x48, 0x85, 0xC0 }); // test rax, rax
+            jumps.emplace_back(as.jump({ 0x0F, static_cast<uint8_t>(0x80 + (ins.op == Op::JUMP_IF_TRUE ? CC_NE : CC_E)) }), target);
+            break;
+        case Op::FOR_PREP: case Op::FOR_PREP_REV:
+            as.loadRax(ins.a);
+            as.loadRcx(ins.a + 1u);
+            as.emit({ 0x48, 0x39, 0xC8 });
+            jumps.emplace_back(as.jump({ 0x0F, static_cast<uint8_t>(0x80 + (ins.op == Op::FOR_PREP ? CC_G : CC_L)) }), target);
+            break;
+        case Op::FOR_LOOP: case Op::FOR_LOOP_REV: {
+            bool forward = ins.op == Op::FOR_LOOP;
+            as.loadRax(ins.a);
+            as.loadRcx(ins.a + 1u);
+            as.emit({ 0x48, 0x39, 0xC8 });
+            jumps.emplace_back(as.jump({ 0x0F, static_cast<uint8_t>(0x80 + (forward ? CC_GE : CC_LE)) }), i + 1);
+            as.emit({ 0x48, 0xFF, static_cast<uint8_t>(forward ? 0xC0 : 0xC8) }); // inc / dec rax
+            as.storeRax(ins.a);
+            jumps.emplace_back(as.jump({ 0xE9 }), target);
+            break;
+        }
+
+        case Op::LENGTH:
+            as.loadRax(ins.b);
+            as.emit({ 0x48, 0x8B, 0x04, 0xC6 }); // mov rax, [rsi + 8 * rax]
+            as.storeRax(ins.a);
+            break;
+        case Op::LOAD:
+            as.loadRax(ins.b);
+            as.emit({ 0x48, 0x8B, 0x84, 0xC6 }); // mov rax, [rsi + 8 * rax + 8 * imm]
+            as.imm32(8 * static_cast<int64_t>(ins.imm));
+            as.storeRax(ins.a);
+            break;
+        case Op::STORE:
+            as.loadRax(ins.a);
+            as.loadRcx(ins.b);
+            as.emit({ 0x48, 0x89, 0x8C, 0xC6 }); // mov [rsi + 8 * rax + 8 * imm], rcx
+            as.imm32(8 * static_cast<int64_t>(ins.imm));
+            break;
+        case Op::INDEX: case Op::INDEX_UNCHECKED: case Op::INDEX_SOA: case Op::INDEX_SOA_UNCHECKED: {
+            bool soa = ins.op == Op::INDEX_SOA || ins.op == Op::INDEX_SOA_UNCHECKED;
+            as.loadRax(ins.b);
+            as.loadRcx(ins.c);
+            as.emit({ 0x48, 0x8B, 0x14, 0xC6 }); // mov rdx, [rsi + 8 * rax], the length
+            if (ins.op == Op::INDEX || ins.op == Op::INDEX_SOA) {
+                as.emit({ 0x48, 0x83, 0xF9, 0x01 }); // cmp rcx, 1
+                checks.emplace_back(as.jump({ 0x0F, 0x80 + CC_L }), static_cast<uint32_t>(i));
+                as.emit({ 0x48, 0x39, 0xD1 });       // cmp rcx, rdx
+                checks.emplace_back(as.jump({ 0x0F, 0x80 + CC_G }), static_cast<uint32_t>(i));
+            }
+            if (soa) {
+                // array + 1 + imm * length + (index - 1)
+                as.emit({ 0x48, 0x69, 0xD2 }); // imul rdx, rdx, imm
+                as.imm32(ins.imm);
+                as.emit({ 0x48, 0x01, 0xD0 }); // add rax, rdx
+                as.emit({ 0x48, 0x01, 0xC8 }); // add rax, rcx
+            } else {
+                // array + 1 + (index - 1) * imm
+                as.emit({ 0x48, 0x69, 0xC9 }); // imul rcx, rcx, imm
+                as.imm32(ins.imm);
+                as.emit({ 0x48, 0x01, 0xC8 }); // add rax, rcx
+                as.emit({ 0x48, 0x05 });       // add rax, 1 - imm
+                as.imm32(1 - static_cast<int64_t>(ins.imm));
+            }
+            as.storeRax(ins.a);
+            break;
+        }
+
+        case Op::RETURN:
+            as.loadRax(ins.a);
+            as.storeRax(0);
+            [[fallthrough]];
+        default: // RETURN_NONE
+            as.movRaxImm(-1);
+            as.emit({ 0xC3 });
+            break;
+        }
+    }
+    // Running off the end returns, as RETURN_NONE
+    offsets[code.size()] = static_cast<uint32_t>(as.code.size());
+    as.movRaxImm(-1);
+    as.emit({ 0xC3 });
+
+    for (const std::pair<size_t, size_t>& jump : jumps) as.patch(jump.first, offsets[jump.second]);
+    for (const std::pair<size_t, uint32_t>& check : checks) {
+        as.patch(check.first, as.code.size());
+        as.movRaxImm(static_cast<int32_t>(check.second));
+        as.emit({ 0xC3 });
+    }
+
+    size_t size = as.code.size();
+    void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) return nullptr;
+    memcpy(memory, as.code.data(), size);
+    if (mprotect(memory, size, PROT_READ | PROT_EXEC) != 0) {
+        munmap(memory, size);
+        return nullptr;
+    }
+    return std::unique_ptr<NativeCode>(new ExecutableCode(memory, size, std::move(offsets)));
+}
+
+#else
+
+inline std::unique_ptr<NativeCode> TemplateJit::compile(const Program&, uint32_t) {
+    return nullptr;
+}
+
+#endif
+
+#endif // JIT_H
@@ -0,0 +1,112 @@
+#ifndef KEYWORDS_H
+#define KEYWORDS_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "token.h"
+
+// Reserved words of the I language. lexer.l matches them with the {ID}
+// rule and classifies the lexeme here, which keeps the flex DFA down to
+// the identifier automaton instead of one branch per keyword.
+
+struct Keyword {
+    const char* name;
+    size_t length;
+    TokenKind kind;
+};
+
+constexpr Keyword KEYWORDS[] = {
+    { "var", 3, TokenKind::KEYWORD_VAR },
+    { "type", 4, TokenKind::KEYWORD_TYPE },
+    { "routine", 7, TokenKind::KEYWORD_ROUTINE },
+    { "print", 5, TokenKind::KEYWORD_PRINT },
+    { "if", 2, TokenKind::KEYWORD_IF },
+    { "else", 4, TokenKind::KEYWORD_ELSE },
+    { "while", 5, TokenKind::KEYWORD_WHILE },
+    { "for", 3, TokenKind::KEYWORD_FOR },
+    { "in", 2, TokenKind::KEYWORD_IN },
+    { "reverse", 7, TokenKind::KEYWORD_REVERSE },
+    { "return", 6, TokenKind::KEYWORD_RETURN },
+    { "is", 2, TokenKind::KEYWORD_IS },
+    { "end", 3, TokenKind::KEYWORD_END },
+    { "loop", 4, TokenKind::KEYWORD_LOOP },
+    { "then", 4, TokenKind::KEYWORD_THEN },
+    { "record", 6, TokenKind::KEYWORD_RECORD },
+    { "array", 5, TokenKind::KEYWORD_ARRAY },
+    { "size", 4, TokenKind::KEYWORD_SIZE },
+
+    { "true", 4, TokenKind::BOOL_LITERAL },
+    { "false", 5, TokenKind::BOOL_LITERAL },
+
+    { "and", 3, TokenKind::AND_OP },
+    { "or", 2, TokenKind::OR_OP },
+    { "xor", 3, TokenKind::XOR_OP },
+    { "not", 3, TokenKind::NOT_OP },
+
+    { "integer", 7, TokenKind::TYPE_INTEGER },
+    { "real", 4, TokenKind::TYPE_REAL },
+    { "boolean", 7, TokenKind::TYPE_BOOLEAN },
+};
+
+constexpr size_t KEYWORD_COUNT = sizeof(KEYWORDS) / sizeof(KEYWORDS[0]);
+constexpr size_t KEYWORD_MIN_LENGTH = 2;
+constexpr size_t KEYWORD_MAX_LENGTH = 7;
+constexpr unsigned KEYWORD_TABLE_BITS = 6;
+
+// First two bytes, last byte and length. These are distinct for every
+// keyword, so a multiplicative hash of them can be made collision free.
+constexpr uint32_t keywordKey(const char* text, size_t length) {
+    return static_cast<uint32_t>(static_cast<unsigned char>(text[0])) << 24
+         | static_cast<uint32_t>(static_cast<unsigned char>(text[1])) << 16
+         | static_cast<uint32_t>(static_cast<unsigned char>(text[length - 1])) << 8
+         | static_cast<uint32_t>(length);
+}
+
+constexpr size_t keywordSlot(uint32_t key, uint32_t seed) {
+    return static_cast<uint32_t>(key * seed) >> (32 - KEYWORD_TABLE_BITS);
+}
+
+// First multiplier in a golden-ratio sequence that maps every keyword to
+// its own slot.
+constexpr uint32_t findKeywordSeed() {
+    for (uint32_t n = 1; ; n++) {
+        uint32_t seed = (n * 0x9E3779B9u) | 1;
+        bool used[size_t(1) << KEYWORD_TABLE_BITS] = {};
+        bool perfect = true;
+        for (const Keyword& keyword : KEYWORDS) {
+            size_t slot = keywordSlot(keywordKey(keyword.name, keyword.length), seed);
+            if (used[slot]) {
+                perfect = false;
+                break;
+            }
+            used[slot] = true;
+        }
+        if (perfect) return seed;
+    }
+}
+
+constexpr uint32_t KEYWORD_SEED = findKeywordSeed();
+
+constexpr std::array<Keyword, size_t(1) << KEYWORD_TABLE_BITS> buildKeywordTable() {
+    std::array<Keyword, size_t(1) << KEYWORD_TABLE_BITS> table = {};
+    for (const Keyword& keyword : KEYWORDS) {
+        table[keywordSlot(keywordKey(keyword.name, keyword.length), KEYWORD_SEED)] = keyword;
+    }
+    return table;
+}
+
+constexpr std::array<Keyword, size_t(1) << KEYWORD_TABLE_BITS> KEYWORD_TABLE = buildKeywordTable();
+
+// Token kind of an identifier-shaped lexeme: its keyword kind, or
+// TokenKind::IDENTIFIER.
+inline TokenKind classifyIdentifier(const char* text, size_t length) {
+    if (length < KEYWORD_MIN_LENGTH || length > KEYWORD_MAX_LENGTH) return TokenKind::IDENTIFIER;
+    const Keyword& entry = KEYWORD_TABLE[keywordSlot(keywordKey(text, length), KEYWORD_SEED)];
+    if (entry.length == length && memcmp(entry.name, text, length) == 0) return entry.kind;
+    return TokenKind::IDENTIFIER;
+}
+
+#endif // KEYWORDS_H
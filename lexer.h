@@ -0,0 +1,180 @@
+#ifndef LEXER_H
+#define LEXER_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <string_view>
+#include <vector>
+
+#include "symbol_table.h"
+#include "token.h"
+
+// A single token as seen by the parser. offset/length locate the lexeme
+// in the input; a LineIndex over the input turns offset into line and
+// column when a diagnostic needs them.
+struct Token {
+    TokenKind kind;
+    uint64_t offset;
+    uint32_t length;
+};
+
+// A run of bytes at which no token starts.
+struct LexError {
+    uint64_t offset;
+    uint32_t length;
+};
+
+// A change to the input: removed bytes at offset were replaced by inserted
+// bytes.
+struct TextEdit {
+    uint64_t offset;
+    uint64_t removed;
+    uint64_t inserted;
+};
+
+// Tokens [first, first + removed) of a buffer were replaced by inserted new
+// tokens.
+struct TokenChange {
+    size_t first;
+    size_t removed;
+    size_t inserted;
+};
+
+// Tokens of one input, stored as parallel arrays so that a pass which only
+// looks at kinds (the parser) walks one byte per token.
+//
+// values holds each token's payload: the symbol id of an IDENTIFIER, the
+// value of an INT_LITERAL (saturated at INT64_MAX) or the bits of a
+// REAL_LITERAL's double, and 0 for everything else.
+class TokenBuffer {
+public:
+    size_t size() const { return kinds.size(); }
+    bool empty() const { return kinds.empty(); }
+
+    // Kind of token i, or TokenKind::END past the last token.
+    TokenKind kind(size_t i) const { return i < kinds.size() ? kinds[i] : TokenKind::END; }
+    uint64_t offset(size_t i) const { return offsets[i]; }
+    uint32_t length(size_t i) const { return lengths[i]; }
+
+    uint32_t symbol(size_t i) const { return static_cast<uint32_t>(values[i]); }
+    std::string_view name(size_t i) const { return symbols.name(symbol(i)); }
+    int64_t intValue(size_t i) const { return static_cast<int64_t>(values[i]); }
+    double realValue(size_t i) const {
+        double value;
+        memcpy(&value, &values[i], sizeof(value));
+        return value;
+    }
+
+    Token operator[](size_t i) const {
+        return Token{ kinds[i], offsets[i], lengths[i] };
+    }
+
+    void push(TokenKind kind, uint64_t offset, uint32_t length, uint64_t value = 0) {
+        kinds.push_back(kind);
+        offsets.push_back(offset);
+        lengths.push_back(length);
+        values.push_back(value);
+    }
+
+    // Appends all of other, moving its identifiers over to this buffer's
+    // symbol ids.
+    void append(const TokenBuffer& other) {
+        size_t first = kinds.size();
+        kinds.insert(kinds.end(), other.kinds.begin(), other.kinds.end());
+        offsets.insert(offsets.end(), other.offsets.begin(), other.offsets.end());
+        lengths.insert(lengths.end(), other.lengths.begin(), other.lengths.end());
+        values.insert(values.end(), other.values.begin(), other.values.end());
+
+        std::vector<uint32_t> remap(other.symbols.size());
+        for (uint32_t id = 0; id < remap.size(); id++) remap[id] = symbols.intern(other.symbols.name(id));
+        for (size_t i = first; i < kinds.size(); i++) {
+            if (kinds[i] == TokenKind::IDENTIFIER) values[i] = remap[values[i]];
+        }
+        errors.insert(errors.end(), other.errors.begin(), other.errors.end());
+    }
+
+    // Replaces the tokens and errors that start in [from, to) with the ones in
+    // other, and moves everything after them by shift bytes.
+    TokenChange replace(uint64_t from, uint64_t to, const TokenBuffer& other, int64_t shift) {
+        size_t first = std::lower_bound(offsets.begin(), offsets.end(), from) - offsets.begin();
+        size_t last = std::lower_bound(offsets.begin() + first, offsets.end(), to) - offsets.begin();
+        size_t count = other.size();
+        kinds.erase(kinds.begin() + first, kinds.begin() + last);
+        offsets.erase(offsets.begin() + first, offsets.begin() + last);
+        lengths.erase(lengths.begin() + first, lengths.begin() + last);
+        values.erase(values.begin() + first, values.begin() + last);
+        kinds.insert(kinds.begin() + first, other.kinds.begin(), other.kinds.end());
+        offsets.insert(offsets.begin() + first, other.offsets.begin(), other.offsets.end());
+        lengths.insert(lengths.begin() + first, other.lengths.begin(), other.lengths.end());
+        values.insert(values.begin() + first, other.values.begin(), other.values.end());
+
+        std::vector<uint32_t> remap(other.symbols.size());
+        for (uint32_t id = 0; id < remap.size(); id++) remap[id] = symbols.intern(other.symbols.name(id));
+        for (size_t i = first; i < first + count; i++) {
+            if (kinds[i] == TokenKind::IDENTIFIER) values[i] = remap[values[i]];
+        }
+        for (size_t i = first + count; i < offsets.size(); i++) offsets[i] += shift;
+
+        auto byOffset = [](const LexError& error, uint64_t offset) { return error.offset < offset; };
+        auto firstError = std::lower_bound(errors.begin(), errors.end(), from, byOffset);
+        auto lastError = std::lower_bound(firstError, errors.end(), to, byOffset);
+        firstError = errors.insert(errors.erase(firstError, lastError), other.errors.begin(), other.errors.end());
+        for (auto error = firstError + other.errors.size(); error != errors.end(); ++error) error->offset += shift;
+
+        return TokenChange{ first, last - first, count };
+    }
+
+    void reserve(size_t n) {
+        kinds.reserve(n);
+        offsets.reserve(n);
+        lengths.reserve(n);
+        values.reserve(n);
+    }
+
+    void clear() {
+        kinds.clear();
+        offsets.clear();
+        lengths.clear();
+        values.clear();
+        symbols.clear();
+        errors.clear();
+    }
+
+    std::vector<TokenKind> kinds;
+    std::vector<uint64_t> offsets;
+    std::vector<uint32_t> lengths;
+    std::vector<uint64_t> values;
+    SymbolTable symbols;
+
+    // Lexical errors met while filling the buffer, in input order
+    std::vector<LexError> errors;
+};
+
+// Tokenizes all of in, appending to tokens. Returns false if the input has
+// lexical errors, which are also listed in tokens.errors. Without recover,
+// scanning stops at the first one; with it, each error becomes an
+// ERROR_TOKEN and scanning goes on after it.
+bool tokenize(std::istream& in, TokenBuffer& tokens, bool recover = false);
+
+// Same as above for input already in memory, e.g. a MappedFile.
+bool tokenize(const char* data, size_t size, TokenBuffer& tokens, bool recover = false);
+
+// Splits data at line boundaries into up to jobs chunks and scans them on
+// separate threads. Produces the same tokens as tokenize(data, size, tokens).
+bool tokenizeParallel(const char* data, size_t size, TokenBuffer& tokens, unsigned jobs,
+                      bool recover = false);
+
+// Scans data and only counts the tokens, for measuring the scanner without
+// the cost of storing or writing them.
+uint64_t countTokens(const char* data, size_t size);
+
+// Updates tokens, produced by tokenize(..., true) from the text before edit,
+// to match data, the text after it. Only the lines touched by the edit are
+// scanned again (always recovering from errors); the tokens after them keep
+// their kinds and values and are only moved. Identifiers that are no longer
+// used stay in tokens.symbols.
+TokenChange relex(const char* data, size_t size, TokenBuffer& tokens, const TextEdit& edit);
+
+#endif // LEXER_H
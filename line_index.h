@@ -0,0 +1,67 @@
+#ifndef LINE_INDEX_H
+#define LINE_INDEX_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Line and column of a byte offset, both 1-based. Columns count bytes.
+struct SourcePosition {
+    uint32_t line;
+    uint32_t column;
+    uint64_t offset;
+};
+
+// Maps byte offsets in a source buffer to line/column. The scanner only
+// records offsets; the newline table is built on the first lookup (one
+// memchr pass) and each lookup is then a binary search. Lookups are not
+// thread-safe until the table exists; call build() first to share one.
+class LineIndex {
+public:
+    LineIndex(const char* data, size_t size) : data(data), size(size), built(false) {}
+
+    void build() {
+        if (built) return;
+        lineStarts.push_back(0);
+        const char* p = data;
+        const char* end = data + size;
+        while (p < end) {
+            const void* newline = memchr(p, '\n', end - p);
+            if (!newline) break;
+            p = static_cast<const char*>(newline) + 1;
+            lineStarts.push_back(p - data);
+        }
+        built = true;
+    }
+
+    SourcePosition position(uint64_t offset) {
+        build();
+        size_t line = std::upper_bound(lineStarts.begin(), lineStarts.end(), offset) - lineStarts.begin();
+        return SourcePosition{ static_cast<uint32_t>(line),
+                               static_cast<uint32_t>(offset - lineStarts[line - 1] + 1), offset };
+    }
+
+    uint32_t line(uint64_t offset) { return position(offset).line; }
+
+    // Offset of the first byte of a 1-based line, or the size of the
+    // source past the last line
+    uint64_t lineStart(uint32_t line) {
+        build();
+        return line >= 1 && line <= lineStarts.size() ? lineStarts[line - 1] : size;
+    }
+
+    size_t lineCount() {
+        build();
+        return lineStarts.size();
+    }
+
+private:
+    const char* data;
+    size_t size;
+    bool built;
+    std::vector<uint64_t> lineStarts;
+};
+
+#endif // LINE_INDEX_H
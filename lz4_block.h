@@ -0,0 +1,158 @@
+#ifndef LZ4_BLOCK_H
+#define LZ4_BLOCK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#ifdef LEXER_LZ4
+#include <lz4.h>
+#endif
+
+// LZ4 block format (no frame header): blocks written here can be read by
+// liblz4's LZ4_decompress_safe() and the other way round. The built-in
+// compressor is a plain greedy matcher with one hash table, so the lexer
+// needs no library. Build with -DLEXER_LZ4 and link -llz4 to use liblz4's
+// faster compressor instead.
+
+// Largest compressed size of n input bytes
+inline size_t lz4Bound(size_t n) {
+    return n + n / 255 + 16;
+}
+
+#ifndef LEXER_LZ4
+
+namespace lz4_detail {
+
+const size_t MIN_MATCH = 4;
+const size_t LAST_LITERALS = 5; // the last 5 bytes are always literals
+const size_t MATCH_LIMIT = 12;  // no match starts in the last 12 bytes
+const int HASH_BITS = 14;
+
+inline uint32_t read32(const char* p) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+inline char* putLength(char* op, size_t length) {
+    for (; length >= 255; length -= 255) *op++ = static_cast<char>(255);
+    *op++ = static_cast<char>(length);
+    return op;
+}
+
+inline char* putSequence(char* op, const char* literals, size_t literalLength, size_t offset, size_t matchLength) {
+    char* token = op++;
+    *token = static_cast<char>((literalLength >= 15 ? 15 : literalLength) << 4);
+    if (literalLength >= 15) op = putLength(op, literalLength - 15);
+    memcpy(op, literals, literalLength);
+    op += literalLength;
+    if (matchLength == 0) return op; // the last sequence has no match
+    *op++ = static_cast<char>(offset);
+    *op++ = static_cast<char>(offset >> 8);
+    size_t m = matchLength - MIN_MATCH;
+    *token |= static_cast<char>(m >= 15 ? 15 : m);
+    if (m >= 15) op = putLength(op, m - 15);
+    return op;
+}
+
+} // namespace lz4_detail
+
+// Compresses n bytes at src into dst, which has room for lz4Bound(n)
+// bytes, and returns the compressed size.
+inline size_t lz4Compress(const char* src, size_t n, char* dst) {
+    using namespace lz4_detail;
+    char* op = dst;
+    size_t ip = 0;
+    size_t anchor = 0;
+    if (n > MATCH_LIMIT) {
+        std::vector<uint32_t> table(size_t(1) << HASH_BITS, UINT32_MAX);
+        size_t limit = n - MATCH_LIMIT;
+        size_t matchEnd = n - LAST_LITERALS;
+        size_t misses = 0;
+        while (ip < limit) {
+            uint32_t sequence = read32(src + ip);
+            uint32_t hash = (sequence * 2654435761u) >> (32 - HASH_BITS);
+            uint32_t candidate = table[hash];
+            table[hash] = static_cast<uint32_t>(ip);
+            if (candidate == UINT32_MAX || ip - candidate > 65535 || read32(src + candidate) != sequence) {
+                ip += 1 + (misses++ >> 6); // skip faster through data that does not compress
+                continue;
+            }
+            misses = 0;
+            size_t length = MIN_MATCH;
+            while (ip + length < matchEnd && src[candidate + length] == src[ip + length]) length++;
+            op = putSequence(op, src + anchor, ip - anchor, ip - candidate, length);
+            ip += length;
+            anchor = ip;
+        }
+    }
+    op = putSequence(op, src + anchor, n - anchor, 0, 0);
+    return static_cast<size_t>(op - dst);
+}
+
+// Decompresses a block of srcSize bytes that expands to exactly dstSize
+// bytes. Returns false for a damaged block.
+inline bool lz4Decompress(const char* src, size_t srcSize, char* dst, size_t dstSize) {
+    using namespace lz4_detail;
+    const unsigned char* ip = reinterpret_cast<const unsigned char*>(src);
+    const unsigned char* end = ip + srcSize;
+    char* op = dst;
+    char* opEnd = dst + dstSize;
+    for (;;) {
+        if (ip == end) return false;
+        unsigned token = *ip++;
+        size_t literals = token >> 4;
+        if (literals == 15) {
+            unsigned byte;
+            do {
+                if (ip == end) return false;
+                byte = *ip++;
+                literals += byte;
+            } while (byte == 255);
+        }
+        if (literals > static_cast<size_t>(end - ip) || literals > static_cast<size_t>(opEnd - op)) return false;
+        memcpy(op, ip, literals);
+        ip += literals;
+        op += literals;
+        if (ip == end) return op == opEnd;
+
+        if (end - ip < 2) return false;
+        size_t offset = ip[0] | (static_cast<size_t>(ip[1]) << 8);
+        ip += 2;
+        if (offset == 0 || offset > static_cast<size_t>(op - dst)) return false;
+        size_t length = (token & 15) + MIN_MATCH;
+        if ((token & 15) == 15) {
+            unsigned byte;
+            do {
+                if (ip == end) return false;
+                byte = *ip++;
+                length += byte;
+            } while (byte == 255);
+        }
+        if (length > static_cast<size_t>(opEnd - op)) return false;
+        const char* match = op - offset;
+        if (offset >= length) {
+            memcpy(op, match, length);
+            op += length;
+        } else {
+            while (length--) *op++ = *match++; // overlapping: repeats the last offset bytes
+        }
+    }
+}
+
+#else
+
+inline size_t lz4Compress(const char* src, size_t n, char* dst) {
+    return static_cast<size_t>(LZ4_compress_default(src, dst, static_cast<int>(n), static_cast<int>(lz4Bound(n))));
+}
+
+inline bool lz4Decompress(const char* src, size_t srcSize, char* dst, size_t dstSize) {
+    return LZ4_decompress_safe(src, dst, static_cast<int>(srcSize), static_cast<int>(dstSize))
+           == static_cast<int>(dstSize);
+}
+
+#endif
+
+#endif // LZ4_BLOCK_H
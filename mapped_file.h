@@ -0,0 +1,71 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Read-only memory mapping of a whole file. Token offsets from the lexer
+// index straight into data(), so lexemes can be looked at through
+// string_views without copying them out.
+class MappedFile {
+public:
+    MappedFile() : base(nullptr), length(0), opened(false) {}
+    ~MappedFile() { close(); }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Maps path; returns false if it cannot be opened or mapped.
+    bool open(const char* path) {
+        close();
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            ::close(fd);
+            return false;
+        }
+        length = static_cast<size_t>(st.st_size);
+        if (length > 0) {
+            void* p = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p == MAP_FAILED) {
+                ::close(fd);
+                length = 0;
+                return false;
+            }
+            base = static_cast<const char*>(p);
+            madvise(p, length, MADV_SEQUENTIAL);
+        }
+        ::close(fd);
+        opened = true;
+        return true;
+    }
+
+    void close() {
+        if (base) munmap(const_cast<char*>(base), length);
+        base = nullptr;
+        length = 0;
+        opened = false;
+    }
+
+    bool is_open() const { return opened; }
+    const char* data() const { return base; }
+    size_t size() const { return length; }
+
+    std::string_view text(uint64_t offset, uint32_t len) const {
+        return std::string_view(base + offset, len);
+    }
+
+private:
+    const char* base;
+    size_t length;
+    bool opened;
+};
+
+#endif // MAPPED_FILE_H
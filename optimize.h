@@ -0,0 +1,349 @@
+#ifndef OPTIMIZE_H
+#define OPTIMIZE_H
+
+#include <bitset>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <vector>
+
+#include "bytecode.h"
+
+struct OptimizeStats {
+    uint64_t folded = 0;           // instructions replaced by a constant load or a plain jump
+    uint64_t checksRemoved = 0;    // INDEX instructions that no longer check bounds
+    uint64_t loopsSpecialized = 0; // counted loops whose entry test was decided
+
+    void merge(const OptimizeStats& other) {
+        folded += other.folded;
+        checksRemoved += other.checksRemoved;
+        loopsSpecialized += other.loopsSpecialized;
+    }
+};
+
+namespace optimize_detail {
+
+// What is known about a register at one point of the routine: nothing, its
+// exact value, or that it refers to an array of a known length.
+struct Fact {
+    enum Kind : uint8_t { UNKNOWN, VALUE, ARRAY } kind = UNKNOWN;
+    Value value{ 0 }; // the value, or the array length
+
+    bool operator==(const Fact& other) const {
+        return kind == other.kind && (kind == UNKNOWN || value.i == other.value.i);
+    }
+};
+
+typedef std::vector<Fact> Facts; // one per register
+typedef std::bitset<256> RegisterSet;
+
+inline bool isJump(Op op) {
+    switch (op) {
+    case Op::JUMP: case Op::JUMP_IF_FALSE: case Op::JUMP_IF_TRUE:
+    case Op::FOR_PREP: case Op::FOR_LOOP: case Op::FOR_PREP_REV: case Op::FOR_LOOP_REV:
+        return true;
+    default:
+        return false;
+    }
+}
+
+inline bool endsBlock(Op op) {
+    return op == Op::JUMP || op == Op::RETURN || op == Op::RETURN_NONE;
+}
+
+// Registers the instruction may change. A call reuses the registers from
+// a upwards as the callee's window.
+inline RegisterSet writes(const Instruction& ins) {
+    RegisterSet set;
+    switch (ins.op) {
+    case Op::STORE: case Op::COPY: case Op::JUMP: case Op::JUMP_IF_FALSE: case Op::JUMP_IF_TRUE:
+    case Op::FOR_PREP: case Op::FOR_PREP_REV: case Op::RETURN: case Op::RETURN_NONE:
+    case Op::PRINT_I: case Op::PRINT_R: case Op::PRINT_B:
+        break;
+    case Op::CALL:
+        for (size_t r = ins.a; r < set.size(); r++) set.set(r);
+        break;
+    default:
+        set.set(ins.a);
+        break;
+    }
+    return set;
+}
+
+// Evaluates an arithmetic, comparison or logic instruction on known
+// operands. Division by zero is left for the interpreter to report.
+inline bool fold(Op op, Value x, Value y, Value& out) {
+    switch (op) {
+    case Op::ADD_I: out.i = static_cast<int64_t>(static_cast<uint64_t>(x.i) + static_cast<uint64_t>(y.i)); return true;
+    case Op::SUB_I: out.i = static_cast<int64_t>(static_cast<uint64_t>(x.i) - static_cast<uint64_t>(y.i)); return true;
+    case Op::MUL_I: out.i = static_cast<int64_t>(static_cast<uint64_t>(x.i) * static_cast<uint64_t>(y.i)); return true;
+    case Op::DIV_I:
+        if (y.i == 0) return false;
+        out.i = (x.i == INT64_MIN && y.i == -1) ? INT64_MIN : x.i / y.i;
+        return true;
+    case Op::MOD_I:
+        if (y.i == 0) return false;
+        out.i = y.i == -1 ? 0 : x.i % y.i;
+        return true;
+    case Op::NEG_I: out.i = static_cast<int64_t>(0 - static_cast<uint64_t>(x.i)); return true;
+    case Op::ADD_R: out.r = x.r + y.r; return true;
+    case Op::SUB_R: out.r = x.r - y.r; return true;
+    case Op::MUL_R: out.r = x.r * y.r; return true;
+    case Op::DIV_R: out.r = x.r / y.r; return true;
+    case Op::NEG_R: out.r = -x.r; return true;
+    case Op::INT_TO_REAL: out.r = static_cast<double>(x.i); return true;
+    case Op::REAL_TO_INT: out.i = std::llround(x.r); return true;
+    case Op::EQ_I: out.i = x.i == y.i; return true;
+    case Op::NE_I: out.i = x.i != y.i; return true;
+    case Op::LT_I: out.i = x.i < y.i; return true;
+    case Op::LE_I: out.i = x.i <= y.i; return true;
+    case Op::EQ_R: out.i = x.r == y.r; return true;
+    case Op::NE_R: out.i = x.r != y.r; return true;
+    case Op::LT_R: out.i = x.r < y.r; return true;
+    case Op::LE_R: out.i = x.r <= y.r; return true;
+    case Op::AND: out.i = x.i & y.i; return true;
+    case Op::OR: out.i = x.i | y.i; return true;
+    case Op::XOR: out.i = x.i ^ y.i; return true;
+    case Op::NOT: out.i = x.i ^ 1; return true;
+    default: return false;
+    }
+}
+
+inline bool isUnary(Op op) {
+    return op == Op::NEG_I || op == Op::NEG_R || op == Op::INT_TO_REAL || op == Op::REAL_TO_INT
+        || op == Op::NOT;
+}
+
+inline int32_t constantIndex(Program& program, Value value) {
+    for (size_t i = 0; i < program.constants.size(); i++) {
+        if (program.constants[i].i == value.i) return static_cast<int32_t>(i);
+    }
+    program.constants.push_back(value);
+    return static_cast<int32_t>(program.constants.size() - 1);
+}
+
+// Loop index bounds that hold inside a loop body, up to its FOR_LOOP
+struct IndexRange {
+    uint8_t reg;
+    int64_t low;
+    int64_t high;
+    size_t end;
+};
+
+} // namespace optimize_detail
+
+// Rewrites one routine of program in place:
+// * arithmetic, comparisons and logic on known values become LOAD_INT or
+//   LOAD_CONST, and conditional jumps on known booleans become a JUMP or
+//   disappear;
+// * a counted loop whose bounds are known loses its entry test (or, if it
+//   never runs, becomes a jump past it);
+// * INDEX and INDEX_SOA skip their bounds check where the index is a loop
+//   index or a constant known to lie within the array's length.
+// Facts flow forward through the code. At a jump target they are merged
+// with the facts at each jump there, and the target of a backward jump
+// forgets every register written after it.
+inline OptimizeStats optimizeRoutine(Program& program, uint32_t routineIndex) {
+    using namespace optimize_detail;
+    OptimizeStats stats;
+    std::vector<Instruction>& code = program.routines[routineIndex].code;
+    size_t n = code.size();
+
+    std::vector<RegisterSet> writtenFrom(n + 1); // written by code[i ..]
+    for (size_t i = n; i-- > 0; ) writtenFrom[i] = writtenFrom[i + 1] | writes(code[i]);
+
+    std::vector<bool> backwardTarget(n + 1, false);
+    std::vector<size_t> loopEnd(n + 1, SIZE_MAX); // body start -> its FOR_LOOP
+    std::vector<size_t> firstJumpFrom(n + 1), lastJumpFrom(n + 1);
+    for (size_t i = 0; i <= n; i++) firstJumpFrom[i] = SIZE_MAX, lastJumpFrom[i] = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (!isJump(code[i].op)) continue;
+        size_t target = i + 1 + code[i].imm;
+        firstJumpFrom[target] = std::min(firstJumpFrom[target], i);
+        lastJumpFrom[target] = std::max(lastJumpFrom[target], i);
+        if (target > i) continue;
+        backwardTarget[target] = true;
+        Op prep = code[i].op == Op::FOR_LOOP ? Op::FOR_PREP : Op::FOR_PREP_REV;
+        if ((code[i].op == Op::FOR_LOOP || code[i].op == Op::FOR_LOOP_REV) && target > 0
+            && code[target - 1].op == prep && code[target - 1].a == code[i].a) {
+            loopEnd[target] = i;
+        }
+    }
+
+    Facts facts(256), prepFacts(256);
+    std::map<size_t, Facts> pending; // facts at forward jumps, by target
+    std::vector<IndexRange> ranges;
+    std::vector<bool> removed(n, false);
+    bool fallsThrough = true;
+
+    for (size_t i = 0; i < n; i++) {
+        auto incoming = pending.find(i);
+        if (incoming != pending.end()) {
+            if (!fallsThrough) {
+                facts = incoming->second;
+            } else {
+                for (size_t r = 0; r < 256; r++) {
+                    if (!(facts[r] == incoming->second[r])) facts[r] = Fact();
+                }
+            }
+            pending.erase(incoming);
+        } else if (!fallsThrough) {
+            facts.assign(256, Fact());
+        }
+        if (backwardTarget[i]) {
+            for (size_t r = 0; r < 256; r++) {
+                if (writtenFrom[i][r]) facts[r] = Fact();
+            }
+        }
+        while (!ranges.empty() && ranges.back().end < i) ranges.pop_back();
+
+        // A loop body whose index is set only by its FOR_LOOP, entered
+        // only from its FOR_PREP, with the bounds known there
+        size_t end = loopEnd[i];
+        if (end != SIZE_MAX) {
+            uint8_t a = code[end].a;
+            bool inside = true;
+            for (size_t t = i; t <= end && inside; t++) {
+                inside = firstJumpFrom[t] == SIZE_MAX || (firstJumpFrom[t] >= i && lastJumpFrom[t] <= end);
+            }
+            RegisterSet body;
+            for (size_t t = i; t < end; t++) body |= writes(code[t]);
+            if (inside && a < 255 && !body[a] && !body[a + 1] && prepFacts[a].kind == Fact::VALUE
+                && prepFacts[a + 1].kind == Fact::VALUE) {
+                int64_t x = prepFacts[a].value.i, y = prepFacts[a + 1].value.i;
+                ranges.push_back(IndexRange{ a, std::min(x, y), std::max(x, y), end });
+            }
+        }
+
+        Instruction& ins = code[i];
+        Fact result;
+        switch (ins.op) {
+        case Op::LOAD_INT:
+            result.kind = Fact::VALUE;
+            result.value.i = ins.imm;
+            break;
+        case Op::LOAD_CONST:
+            result.kind = Fact::VALUE;
+            result.value = program.constants[ins.imm];
+            break;
+        case Op::MOVE:
+            result = facts[ins.b];
+            break;
+        case Op::NEW_ARRAY:
+            if (facts[ins.b].kind == Fact::VALUE) {
+                result.kind = Fact::ARRAY;
+                result.value = facts[ins.b].value;
+            }
+            break;
+        case Op::LENGTH:
+            if (facts[ins.b].kind == Fact::ARRAY) {
+                result.kind = Fact::VALUE;
+                result.value = facts[ins.b].value;
+            }
+            break;
+        case Op::INDEX:
+        case Op::INDEX_SOA: {
+            const Fact& array = facts[ins.b];
+            if (array.kind != Fact::ARRAY) break;
+            int64_t length = array.value.i;
+            bool safe = facts[ins.c].kind == Fact::VALUE
+                && facts[ins.c].value.i >= 1 && facts[ins.c].value.i <= length;
+            for (const IndexRange& range : ranges) {
+                if (range.reg == ins.c && range.low >= 1 && range.high <= length) safe = true;
+            }
+            if (safe) {
+                ins.op = ins.op == Op::INDEX ? Op::INDEX_UNCHECKED : Op::INDEX_SOA_UNCHECKED;
+                stats.checksRemoved++;
+            }
+            break;
+        }
+        case Op::JUMP_IF_FALSE:
+        case Op::JUMP_IF_TRUE:
+            if (facts[ins.a].kind == Fact::VALUE) {
+                bool taken = (facts[ins.a].value.i != 0) == (ins.op == Op::JUMP_IF_TRUE);
+                if (taken) ins.op = Op::JUMP;
+                else removed[i] = true;
+                stats.folded++;
+            }
+            break;
+        case Op::FOR_PREP:
+        case Op::FOR_PREP_REV:
+            prepFacts = facts;
+            if (ins.a < 255 && facts[ins.a].kind == Fact::VALUE && facts[ins.a + 1].kind == Fact::VALUE) {
+                int64_t index = facts[ins.a].value.i, limit = facts[ins.a + 1].value.i;
+                bool runs = ins.op == Op::FOR_PREP ? index <= limit : index >= limit;
+                if (runs) removed[i] = true;
+                else ins.op = Op::JUMP;
+                stats.loopsSpecialized++;
+            }
+            break;
+        default:
+            if (facts[ins.b].kind == Fact::VALUE
+                && (isUnary(ins.op) || facts[ins.c].kind == Fact::VALUE)
+                && fold(ins.op, facts[ins.b].value, facts[ins.c].value, result.value)) {
+                result.kind = Fact::VALUE;
+                if (result.value.i >= INT32_MIN && result.value.i <= INT32_MAX) {
+                    ins = Instruction{ Op::LOAD_INT, ins.a, 0, 0, static_cast<int32_t>(result.value.i) };
+                } else {
+                    ins = Instruction{ Op::LOAD_CONST, ins.a, 0, 0, constantIndex(program, result.value) };
+                }
+                stats.folded++;
+            }
+            break;
+        }
+
+        if (removed[i]) {
+            fallsThrough = true; // a test that never jumps, or a loop entry that always runs
+            continue;
+        }
+        RegisterSet written = writes(ins);
+        for (size_t r = 0; r < 256; r++) {
+            if (written[r]) facts[r] = Fact();
+        }
+        if (written.count() == 1) facts[ins.a] = result;
+
+        if (isJump(ins.op) && ins.imm >= 0) {
+            size_t target = i + 1 + ins.imm;
+            auto existing = pending.find(target);
+            if (existing == pending.end()) {
+                pending.emplace(target, facts);
+            } else {
+                for (size_t r = 0; r < 256; r++) {
+                    if (!(existing->second[r] == facts[r])) existing->second[r] = Fact();
+                }
+            }
+        }
+        fallsThrough = !endsBlock(ins.op);
+    }
+
+    // Drop the removed instructions and retarget the jumps
+    std::vector<size_t> newIndex(n + 1);
+    size_t kept = 0;
+    for (size_t i = 0; i < n; i++) {
+        newIndex[i] = kept;
+        if (!removed[i]) kept++;
+    }
+    newIndex[n] = kept;
+    size_t out = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (removed[i]) continue;
+        Instruction ins = code[i];
+        if (isJump(ins.op)) {
+            size_t target = i + 1 + ins.imm;
+            ins.imm = static_cast<int32_t>(newIndex[target]) - static_cast<int32_t>(out) - 1;
+        }
+        code[out++] = ins;
+    }
+    code.resize(out);
+    return stats;
+}
+
+inline OptimizeStats optimizeProgram(Program& program) {
+    OptimizeStats stats;
+    for (uint32_t i = 0; i < program.routines.size(); i++) stats.merge(optimizeRoutine(program, i));
+    return stats;
+}
+
+#endif // OPTIMIZE_H
@@ -0,0 +1,65 @@
+#ifndef OUTPUT_BUFFER_H
+#define OUTPUT_BUFFER_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <ostream>
+
+#include "trace.h"
+
+// Gathers many small writes in a 1 MB block and hands the block to the
+// stream in one write() when it fills, so the stream's sentry, locale and
+// streambuf calls are paid once per megabyte instead of once per token.
+class OutputBuffer {
+public:
+    static const size_t CAPACITY = 1 << 20;
+
+    explicit OutputBuffer(std::ostream& out) : out(out), data(new char[CAPACITY]), used(0) {}
+    ~OutputBuffer() { flush(); }
+
+    OutputBuffer(const OutputBuffer&) = delete;
+    OutputBuffer& operator=(const OutputBuffer&) = delete;
+
+    void write(const char* p, size_t n) {
+        if (n > CAPACITY - used) {
+            flush();
+            if (n > CAPACITY) {
+                writeOut(p, n);
+                return;
+            }
+        }
+        memcpy(data.get() + used, p, n);
+        used += n;
+    }
+
+    void put(char c) {
+        if (used == CAPACITY) flush();
+        data[used++] = c;
+    }
+
+    void flush() {
+        if (used > 0) {
+            writeOut(data.get(), used);
+            used = 0;
+        }
+    }
+
+    // Time spent handing blocks to the stream, for --stats
+    std::chrono::nanoseconds writeTime{0};
+
+private:
+    void writeOut(const char* p, size_t n) {
+        LEXER_TRACE_SCOPE("write");
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        out.write(p, n);
+        writeTime += std::chrono::steady_clock::now() - start;
+    }
+
+    std::ostream& out;
+    std::unique_ptr<char[]> data;
+    size_t used;
+};
+
+#endif // OUTPUT_BUFFER_H
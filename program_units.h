@@ -0,0 +1,86 @@
+#ifndef PROGRAM_UNITS_H
+#define PROGRAM_UNITS_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "lexer.h"
+#include "token.h"
+
+// Top-level declarations of a program, found from the tokens alone so
+// that later passes can treat each routine as an independent task.
+enum class UnitKind : uint8_t { Variable, Type, Routine };
+
+// Tokens [first, end) of one top-level declaration
+struct ProgramUnit {
+    UnitKind kind;
+    uint32_t first;
+    uint32_t end;
+};
+
+// Splits tokens at the var, type and routine keywords that are not nested
+// in a block. The blocks are record ... end, then ... end, loop ... end and
+// a routine's is ... end; a routine written with => has no end. Tokens
+// before the first declaration (only in erroneous input) are skipped.
+inline std::vector<ProgramUnit> splitProgramUnits(const TokenBuffer& tokens) {
+    std::vector<ProgramUnit> units;
+    uint32_t depth = 0;
+    bool routineHeader = false; // between routine and its is or =>
+    for (uint32_t i = 0; i < tokens.size(); i++) {
+        TokenKind kind = tokens.kind(i);
+        if (depth == 0) {
+            if (kind == TokenKind::KEYWORD_VAR || kind == TokenKind::KEYWORD_TYPE
+                || kind == TokenKind::KEYWORD_ROUTINE) {
+                if (!units.empty()) units.back().end = i;
+                UnitKind unit = kind == TokenKind::KEYWORD_VAR ? UnitKind::Variable
+                              : kind == TokenKind::KEYWORD_TYPE ? UnitKind::Type : UnitKind::Routine;
+                units.push_back(ProgramUnit{ unit, i, i });
+                routineHeader = unit == UnitKind::Routine;
+                continue;
+            }
+            if (routineHeader && (kind == TokenKind::KEYWORD_IS || kind == TokenKind::EQ_GT)) {
+                routineHeader = false;
+                if (kind == TokenKind::KEYWORD_IS) depth++;
+                continue;
+            }
+        }
+        if (kind == TokenKind::KEYWORD_RECORD || kind == TokenKind::KEYWORD_THEN
+            || kind == TokenKind::KEYWORD_LOOP) {
+            depth++;
+        } else if (kind == TokenKind::KEYWORD_END && depth > 0) {
+            depth--;
+        }
+    }
+    if (!units.empty()) units.back().end = static_cast<uint32_t>(tokens.size());
+    return units;
+}
+
+// Runs fn(unit) for every routine on up to jobs threads, largest routines
+// first so that one big routine does not end up last on an otherwise idle
+// machine. Threads take the next routine from a shared counter, as batch
+// mode does with files. Variable and type units are left to the caller,
+// which resolves them before calling this so that fn sees them read-only.
+template <typename Fn>
+void forEachRoutine(const std::vector<ProgramUnit>& units, unsigned jobs, Fn&& fn) {
+    std::vector<const ProgramUnit*> routines;
+    for (const ProgramUnit& unit : units) {
+        if (unit.kind == UnitKind::Routine) routines.push_back(&unit);
+    }
+    std::stable_sort(routines.begin(), routines.end(), [](const ProgramUnit* a, const ProgramUnit* b) {
+        return a->end - a->first > b->end - b->first;
+    });
+
+    std::atomic<size_t> next(0);
+    auto worker = [&] {
+        for (size_t i; (i = next++) < routines.size(); ) fn(*routines[i]);
+    };
+    std::vector<std::thread> workers;
+    for (unsigned i = 1; i < jobs && i < routines.size(); i++) workers.emplace_back(worker);
+    worker();
+    for (std::thread& w : workers) w.join();
+}
+
+#endif // PROGRAM_UNITS_H
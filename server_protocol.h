@@ -0,0 +1,117 @@
+#ifndef SERVER_PROTOCOL_H
+#define SERVER_PROTOCOL_H
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Wire format of the --serve daemon, for the server and its clients. A
+// client connects to the Unix socket and sends any number of requests,
+// each answered by one response before the next is read:
+//
+//   request  : <kind byte> <format byte> <flags byte> <0 byte> <u32 length> <payload>
+//   response : <status byte> <3 zero bytes> <u32 diagnostics length> <u64 tokens length>
+//              <token stream> <diagnostics>
+//
+// Integers are little-endian. The payload is the source text itself for
+// REQUEST_SOURCE, or the path of a file for the server to map for
+// REQUEST_FILE. The token stream is in the requested format, exactly as
+// the command line would write it, and the diagnostics are the
+// path:line:column messages it would print.
+
+enum : uint8_t { REQUEST_SOURCE = 'S', REQUEST_FILE = 'F' };
+enum : uint8_t { FORMAT_BINARY = 0, FORMAT_COMPRESSED = 1, FORMAT_TEXT = 2 };
+enum : uint8_t { REQUEST_RECOVER = 1 }; // flags: ERROR_TOKENs instead of stopping
+
+// STATUS_BAD_REQUEST answers a request that cannot be served, such as a
+// file that does not open; the diagnostics say why. After a malformed
+// header the server also closes the connection.
+enum : uint8_t { STATUS_OK = 0, STATUS_LEXICAL_ERRORS = 1, STATUS_BAD_REQUEST = 2 };
+
+const size_t REQUEST_HEADER_SIZE = 8;
+const size_t RESPONSE_HEADER_SIZE = 16;
+const uint32_t MAX_REQUEST_PAYLOAD = 1u << 30;
+
+struct RequestHeader {
+    uint8_t kind = REQUEST_SOURCE;
+    uint8_t format = FORMAT_BINARY;
+    uint8_t flags = 0;
+    uint32_t length = 0;
+};
+
+struct ResponseHeader {
+    uint8_t status = STATUS_OK;
+    uint32_t diagnosticsLength = 0;
+    uint64_t tokensLength = 0;
+};
+
+inline void encodeRequestHeader(const RequestHeader& header, char* p) {
+    p[0] = static_cast<char>(header.kind);
+    p[1] = static_cast<char>(header.format);
+    p[2] = static_cast<char>(header.flags);
+    p[3] = 0;
+    memcpy(p + 4, &header.length, 4);
+}
+
+inline bool decodeRequestHeader(const char* p, RequestHeader& header) {
+    header.kind = static_cast<uint8_t>(p[0]);
+    header.format = static_cast<uint8_t>(p[1]);
+    header.flags = static_cast<uint8_t>(p[2]);
+    memcpy(&header.length, p + 4, 4);
+    return (header.kind == REQUEST_SOURCE || header.kind == REQUEST_FILE) && header.format <= FORMAT_TEXT
+           && header.length <= MAX_REQUEST_PAYLOAD;
+}
+
+inline void encodeResponseHeader(const ResponseHeader& header, char* p) {
+    p[0] = static_cast<char>(header.status);
+    p[1] = p[2] = p[3] = 0;
+    memcpy(p + 4, &header.diagnosticsLength, 4);
+    memcpy(p + 8, &header.tokensLength, 8);
+}
+
+inline void decodeResponseHeader(const char* p, ResponseHeader& header) {
+    header.status = static_cast<uint8_t>(p[0]);
+    memcpy(&header.diagnosticsLength, p + 4, 4);
+    memcpy(&header.tokensLength, p + 8, 8);
+}
+
+// Reads exactly n bytes; false on end of stream or error.
+inline bool readFull(int fd, char* p, size_t n) {
+    while (n > 0) {
+        ssize_t got = ::read(fd, p, n);
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) return false;
+        p += got;
+        n -= static_cast<size_t>(got);
+    }
+    return true;
+}
+
+// Writes all n bytes. A peer that went away is an error, not a SIGPIPE.
+inline bool writeFull(int fd, const char* p, size_t n) {
+    while (n > 0) {
+        ssize_t put = ::send(fd, p, n, MSG_NOSIGNAL);
+        if (put < 0 && errno == EINTR) continue;
+        if (put <= 0) return false;
+        p += put;
+        n -= static_cast<size_t>(put);
+    }
+    return true;
+}
+
+// Fills a sockaddr_un for path; false if the path does not fit.
+inline bool socketAddress(const std::string& path, sockaddr_un& address) {
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(address.sun_path)) return false;
+    memcpy(address.sun_path, path.data(), path.size());
+    return true;
+}
+
+#endif // SERVER_PROTOCOL_H
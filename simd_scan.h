@@ -0,0 +1,223 @@
+#ifndef SIMD_SCAN_H
+#define SIMD_SCAN_H
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SIMD_SCAN_X86 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define SIMD_SCAN_NEON 1
+#endif
+
+// Block scanners for the two things the lexer skips most, runs of
+// whitespace and the rest of a // comment, and for the text in between,
+// which runs up to the next whitespace byte or '/'. Each returns the first
+// position in [p, end) that stops the run, or end. On x86 the AVX2 or SSE2
+// version is picked at run time; ARM uses NEON; anything else, or a build
+// with -DLEXER_NO_SIMD, uses the scalar loops.
+
+namespace simd {
+
+inline bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+inline const char* skipSpacesScalar(const char* p, const char* end) {
+    while (p < end && isSpace(*p)) p++;
+    return p;
+}
+
+inline const char* findNewlineScalar(const char* p, const char* end) {
+    while (p < end && *p != '\n') p++;
+    return p;
+}
+
+inline const char* findSpaceOrSlashScalar(const char* p, const char* end) {
+    while (p < end && !isSpace(*p) && *p != '/') p++;
+    return p;
+}
+
+#if defined(SIMD_SCAN_X86) && !defined(LEXER_NO_SIMD)
+
+inline const char* skipSpacesSse2(const char* p, const char* end) {
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i cr = _mm_set1_epi8('\r');
+    const __m128i lf = _mm_set1_epi8('\n');
+    for (; end - p >= 16; p += 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        __m128i spaces = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(block, space), _mm_cmpeq_epi8(block, tab)),
+                                      _mm_or_si128(_mm_cmpeq_epi8(block, cr), _mm_cmpeq_epi8(block, lf)));
+        unsigned stop = ~static_cast<unsigned>(_mm_movemask_epi8(spaces)) & 0xffff;
+        if (stop) return p + __builtin_ctz(stop);
+    }
+    return skipSpacesScalar(p, end);
+}
+
+inline const char* findNewlineSse2(const char* p, const char* end) {
+    const __m128i lf = _mm_set1_epi8('\n');
+    for (; end - p >= 16; p += 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        unsigned hit = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, lf)));
+        if (hit) return p + __builtin_ctz(hit);
+    }
+    return findNewlineScalar(p, end);
+}
+
+inline const char* findSpaceOrSlashSse2(const char* p, const char* end) {
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i cr = _mm_set1_epi8('\r');
+    const __m128i lf = _mm_set1_epi8('\n');
+    const __m128i slash = _mm_set1_epi8('/');
+    for (; end - p >= 16; p += 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        __m128i stops = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(block, space), _mm_cmpeq_epi8(block, tab)),
+                                     _mm_or_si128(_mm_cmpeq_epi8(block, cr), _mm_cmpeq_epi8(block, lf)));
+        stops = _mm_or_si128(stops, _mm_cmpeq_epi8(block, slash));
+        unsigned hit = static_cast<unsigned>(_mm_movemask_epi8(stops));
+        if (hit) return p + __builtin_ctz(hit);
+    }
+    return findSpaceOrSlashScalar(p, end);
+}
+
+__attribute__((target("avx2")))
+inline const char* skipSpacesAvx2(const char* p, const char* end) {
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i cr = _mm256_set1_epi8('\r');
+    const __m256i lf = _mm256_set1_epi8('\n');
+    for (; end - p >= 32; p += 32) {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        __m256i spaces = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(block, space), _mm256_cmpeq_epi8(block, tab)),
+            _mm256_or_si256(_mm256_cmpeq_epi8(block, cr), _mm256_cmpeq_epi8(block, lf)));
+        uint32_t stop = ~static_cast<uint32_t>(_mm256_movemask_epi8(spaces));
+        if (stop) return p + __builtin_ctz(stop);
+    }
+    return skipSpacesSse2(p, end);
+}
+
+__attribute__((target("avx2")))
+inline const char* findNewlineAvx2(const char* p, const char* end) {
+    const __m256i lf = _mm256_set1_epi8('\n');
+    for (; end - p >= 32; p += 32) {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        uint32_t hit = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, lf)));
+        if (hit) return p + __builtin_ctz(hit);
+    }
+    return findNewlineSse2(p, end);
+}
+
+__attribute__((target("avx2")))
+inline const char* findSpaceOrSlashAvx2(const char* p, const char* end) {
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i cr = _mm256_set1_epi8('\r');
+    const __m256i lf = _mm256_set1_epi8('\n');
+    const __m256i slash = _mm256_set1_epi8('/');
+    for (; end - p >= 32; p += 32) {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        __m256i stops = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(block, space), _mm256_cmpeq_epi8(block, tab)),
+            _mm256_or_si256(_mm256_cmpeq_epi8(block, cr), _mm256_cmpeq_epi8(block, lf)));
+        stops = _mm256_or_si256(stops, _mm256_cmpeq_epi8(block, slash));
+        uint32_t hit = static_cast<uint32_t>(_mm256_movemask_epi8(stops));
+        if (hit) return p + __builtin_ctz(hit);
+    }
+    return findSpaceOrSlashSse2(p, end);
+}
+
+typedef const char* (*ScanFunction)(const char*, const char*);
+
+inline ScanFunction selectSkipSpaces() {
+    return __builtin_cpu_supports("avx2") ? skipSpacesAvx2 : skipSpacesSse2;
+}
+
+inline ScanFunction selectFindNewline() {
+    return __builtin_cpu_supports("avx2") ? findNewlineAvx2 : findNewlineSse2;
+}
+
+inline ScanFunction selectFindSpaceOrSlash() {
+    return __builtin_cpu_supports("avx2") ? findSpaceOrSlashAvx2 : findSpaceOrSlashSse2;
+}
+
+inline const char* skipSpaces(const char* p, const char* end) {
+    // A single space between tokens is the common case
+    if (p == end || !isSpace(*p)) return p;
+    static const ScanFunction impl = selectSkipSpaces();
+    return impl(p, end);
+}
+
+inline const char* findNewline(const char* p, const char* end) {
+    static const ScanFunction impl = selectFindNewline();
+    return impl(p, end);
+}
+
+inline const char* findSpaceOrSlash(const char* p, const char* end) {
+    static const ScanFunction impl = selectFindSpaceOrSlash();
+    return impl(p, end);
+}
+
+#elif defined(SIMD_SCAN_NEON) && !defined(LEXER_NO_SIMD)
+
+// Narrows a 16 x 8-bit mask to 16 x 4 bits in a 64-bit integer, so the
+// first set lane is ctz / 4
+inline uint64_t neonMask(uint8x16_t mask) {
+    return vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(mask), 4)), 0);
+}
+
+inline const char* skipSpaces(const char* p, const char* end) {
+    if (p == end || !isSpace(*p)) return p;
+    for (; end - p >= 16; p += 16) {
+        uint8x16_t block = vld1q_u8(reinterpret_cast<const uint8_t*>(p));
+        uint8x16_t spaces = vorrq_u8(vorrq_u8(vceqq_u8(block, vdupq_n_u8(' ')), vceqq_u8(block, vdupq_n_u8('\t'))),
+                                     vorrq_u8(vceqq_u8(block, vdupq_n_u8('\r')), vceqq_u8(block, vdupq_n_u8('\n'))));
+        uint64_t stop = ~neonMask(spaces);
+        if (stop) return p + (__builtin_ctzll(stop) >> 2);
+    }
+    return skipSpacesScalar(p, end);
+}
+
+inline const char* findNewline(const char* p, const char* end) {
+    for (; end - p >= 16; p += 16) {
+        uint8x16_t block = vld1q_u8(reinterpret_cast<const uint8_t*>(p));
+        uint64_t hit = neonMask(vceqq_u8(block, vdupq_n_u8('\n')));
+        if (hit) return p + (__builtin_ctzll(hit) >> 2);
+    }
+    return findNewlineScalar(p, end);
+}
+
+inline const char* findSpaceOrSlash(const char* p, const char* end) {
+    for (; end - p >= 16; p += 16) {
+        uint8x16_t block = vld1q_u8(reinterpret_cast<const uint8_t*>(p));
+        uint8x16_t stops = vorrq_u8(vorrq_u8(vceqq_u8(block, vdupq_n_u8(' ')), vceqq_u8(block, vdupq_n_u8('\t'))),
+                                    vorrq_u8(vceqq_u8(block, vdupq_n_u8('\r')), vceqq_u8(block, vdupq_n_u8('\n'))));
+        uint64_t hit = neonMask(vorrq_u8(stops, vceqq_u8(block, vdupq_n_u8('/'))));
+        if (hit) return p + (__builtin_ctzll(hit) >> 2);
+    }
+    return findSpaceOrSlashScalar(p, end);
+}
+
+#else
+
+inline const char* skipSpaces(const char* p, const char* end) {
+    return skipSpacesScalar(p, end);
+}
+
+inline const char* findNewline(const char* p, const char* end) {
+    return findNewlineScalar(p, end);
+}
+
+inline const char* findSpaceOrSlash(const char* p, const char* end) {
+    return findSpaceOrSlashScalar(p, end);
+}
+
+#endif
+
+} // namespace simd
+
+#endif // SIMD_SCAN_H
@@ -0,0 +1,108 @@
+#ifndef SYMBOL_TABLE_H
+#define SYMBOL_TABLE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+// Interned identifier names. Each distinct name is copied once into an
+// arena of large blocks and gets a dense 32-bit id, so collecting the
+// identifiers of a file costs a handful of allocations, not one per token.
+class SymbolTable {
+public:
+    SymbolTable() : cursor(nullptr), blockEnd(nullptr) {}
+
+    SymbolTable(const SymbolTable&) = delete;
+    SymbolTable& operator=(const SymbolTable&) = delete;
+    SymbolTable(SymbolTable&&) = default;
+    SymbolTable& operator=(SymbolTable&&) = default;
+
+    // Id of the name, adding it if it is new. Ids are assigned 0, 1, 2, ...
+    uint32_t intern(const char* text, size_t length) {
+        if (names.size() * 2 >= slots.size()) grow();
+        uint32_t hash = hashOf(text, length);
+        size_t mask = slots.size() - 1;
+        for (size_t i = hash & mask; ; i = (i + 1) & mask) {
+            uint32_t slot = slots[i];
+            if (slot == 0) {
+                uint32_t id = static_cast<uint32_t>(names.size());
+                names.push_back(store(text, length));
+                hashes.push_back(hash);
+                slots[i] = id + 1;
+                return id;
+            }
+            uint32_t id = slot - 1;
+            if (hashes[id] == hash && names[id].size() == length
+                && memcmp(names[id].data(), text, length) == 0) {
+                return id;
+            }
+        }
+    }
+
+    uint32_t intern(std::string_view name) { return intern(name.data(), name.size()); }
+
+    std::string_view name(uint32_t id) const { return names[id]; }
+    size_t size() const { return names.size(); }
+
+    void clear() {
+        names.clear();
+        hashes.clear();
+        std::fill(slots.begin(), slots.end(), 0);
+        if (!blocks.empty()) {
+            blocks.resize(1);
+            cursor = blocks[0].get();
+            blockEnd = cursor + BLOCK_SIZE;
+        }
+    }
+
+private:
+    static const size_t BLOCK_SIZE = 64 * 1024;
+
+    // FNV-1a
+    static uint32_t hashOf(const char* text, size_t length) {
+        uint32_t hash = 2166136261u;
+        for (size_t i = 0; i < length; i++) {
+            hash = (hash ^ static_cast<unsigned char>(text[i])) * 16777619u;
+        }
+        return hash;
+    }
+
+    std::string_view store(const char* text, size_t length) {
+        if (static_cast<size_t>(blockEnd - cursor) < length) {
+            // Names longer than a block get a block of their own
+            size_t size = length > BLOCK_SIZE ? length : BLOCK_SIZE;
+            blocks.emplace_back(new char[size]);
+            cursor = blocks.back().get();
+            blockEnd = cursor + size;
+        }
+        memcpy(cursor, text, length);
+        std::string_view stored(cursor, length);
+        cursor += length;
+        return stored;
+    }
+
+    void grow() {
+        std::vector<uint32_t> bigger(slots.empty() ? 1024 : slots.size() * 2, 0);
+        size_t mask = bigger.size() - 1;
+        for (uint32_t id = 0; id < names.size(); id++) {
+            size_t i = hashes[id] & mask;
+            while (bigger[i] != 0) i = (i + 1) & mask;
+            bigger[i] = id + 1;
+        }
+        slots.swap(bigger);
+    }
+
+    std::vector<std::unique_ptr<char[]>> blocks;
+    char* cursor;
+    char* blockEnd;
+
+    std::vector<std::string_view> names;
+    std::vector<uint32_t> hashes;
+    std::vector<uint32_t> slots; // id + 1, 0 = empty
+};
+
+#endif // SYMBOL_TABLE_H
@@ -0,0 +1,40 @@
+#ifndef TESTS_CHECK_H
+#define TESTS_CHECK_H
+
+#include <iostream>
+
+// Minimal test support. CHECK and CHECK_EQ report a failed condition with
+// its location and carry on, so one run lists every failure; main()
+// returns testStatus().
+
+inline int& testFailures() {
+    static int failures = 0;
+    return failures;
+}
+
+inline int testStatus() {
+    if (testFailures() > 0) std::cerr << testFailures() << " checks failed" << std::endl;
+    return testFailures() > 0 ? 1 : 0;
+}
+
+#define CHECK(condition)                                                            \
+    do {                                                                            \
+        if (!(condition)) {                                                         \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #condition ")"   \
+                      << " failed" << std::endl;                                    \
+            testFailures()++;                                                       \
+        }                                                                           \
+    } while (0)
+
+#define CHECK_EQ(actual, expected)                                                  \
+    do {                                                                            \
+        auto checkActual = (actual);                                                \
+        auto checkExpected = (expected);                                            \
+        if (!(checkActual == checkExpected)) {                                      \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": " #actual " is "         \
+                      << checkActual << ", expected " << checkExpected << std::endl; \
+            testFailures()++;                                                       \
+        }                                                                           \
+    } while (0)
+
+#endif // TESTS_CHECK_H
@@ -0,0 +1,249 @@
+// The LZ4 block codec round-trips every kind of data, the compressed token
+// stream reads back token for token and by source offset across block
+// boundaries, and damaged blocks and indexes are rejected.
+
+#include <cstdint>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "check.h"
+#include "lz4_block.h"
+#include "token_stream.h"
+
+static std::mt19937 rng(17);
+
+// n bytes drawn from the first alphabet letters of the byte range; 256
+// gives data that does not compress
+static std::string randomBytes(size_t n, unsigned alphabet) {
+    std::string bytes(n, '\0');
+    for (char& c : bytes) c = static_cast<char>(rng() % alphabet);
+    return bytes;
+}
+
+static bool roundTrips(const std::string& data) {
+    std::vector<char> compressed(lz4Bound(data.size()));
+    size_t size = lz4Compress(data.data(), data.size(), compressed.data());
+    if (size > compressed.size()) return false;
+    std::string out(data.size(), '\0');
+    if (!lz4Decompress(compressed.data(), size, &out[0], out.size())) return false;
+    return out == data;
+}
+
+static std::string compress(const std::string& data) {
+    std::vector<char> compressed(lz4Bound(data.size()));
+    return std::string(compressed.data(), lz4Compress(data.data(), data.size(), compressed.data()));
+}
+
+static bool decompresses(const std::string& block, size_t size) {
+    std::string out(size, '\0');
+    return lz4Decompress(block.data(), block.size(), &out[0], out.size());
+}
+
+static void checkCodec() {
+    const size_t sizes[] = { 0, 1, 4, 5, 12, 13, 14, 15, 16, 100, 270, 4096, 65535, 65536, 65537, 300000 };
+    for (size_t n : sizes) {
+        for (unsigned alphabet : { 1u, 2u, 4u, 26u, 256u }) {
+            CHECK(roundTrips(randomBytes(n, alphabet)));
+        }
+    }
+
+    // Literal and match lengths of 15 and more take extra length bytes;
+    // offsets up to 65535 and matches that overlap their own output
+    std::string mixed;
+    for (size_t run : { 14, 15, 16, 269, 270, 271, 1000 }) {
+        mixed += randomBytes(run, 256);
+        mixed += std::string(run, 'x');
+        mixed += mixed.substr(0, run);
+    }
+    mixed += randomBytes(65530, 256) + mixed.substr(0, 100);
+    CHECK(roundTrips(mixed));
+    std::string pattern;
+    for (int i = 0; i < 10000; i++) pattern += "var x : integer := " + std::to_string(i % 97) + ";\n";
+    CHECK(roundTrips(pattern));
+    CHECK(compress(pattern).size() < pattern.size() / 4);
+
+    // Incompressible data grows by no more than lz4Bound() allows
+    std::string noise = randomBytes(100000, 256);
+    CHECK(compress(noise).size() <= lz4Bound(noise.size()));
+
+    // A block decodes to exactly its size: every shorter block, a wrong
+    // size, or a match reaching before the output is rejected
+    std::string block = compress(pattern.substr(0, 5000));
+    CHECK(decompresses(block, 5000));
+    CHECK(!decompresses(block, 4999));
+    CHECK(!decompresses(block, 5001));
+    for (size_t cut = 0; cut < block.size(); cut++) CHECK(!decompresses(block.substr(0, cut), 5000));
+    CHECK(!decompresses(std::string("\x04" "abcd" "\x00\x00", 7), 8)); // offset 0
+    CHECK(!decompresses(std::string("\x04" "abcd" "\x05\x00", 7), 8)); // offset past the start
+    CHECK(!decompresses(std::string("\x50" "abc", 4), 5));            // literals past the end
+    CHECK(!decompresses(std::string("\xf0", 1), 15));                 // length byte missing
+
+    // Damaged bytes never read or write outside the buffers
+    for (size_t i = 0; i < block.size(); i++) {
+        std::string damaged = block;
+        damaged[i] = static_cast<char>(damaged[i] ^ (1 + rng() % 255));
+        decompresses(damaged, 5000);
+    }
+}
+
+struct Record {
+    TokenKind kind;
+    uint64_t offset;
+    uint64_t length;
+};
+
+static std::string writeStream(const std::vector<Record>& records) {
+    std::ostringstream out;
+    CompressedTokenWriter writer(out);
+    for (const Record& r : records) writer.put(r.kind, r.offset, r.length);
+    writer.finish();
+    return out.str();
+}
+
+// The stream with its index replaced by blocks
+static std::string withIndex(const std::string& stream, const std::vector<CompressedBlock>& blocks) {
+    uint64_t indexOffset = 0;
+    for (int i = 0; i < 8; i++) {
+        indexOffset |= static_cast<uint64_t>(static_cast<unsigned char>(stream[stream.size() - 8 + i])) << (8 * i);
+    }
+    std::string out = stream.substr(0, indexOffset);
+    char buf[10];
+    out.append(buf, encodeVarint(buf, blocks.size()));
+    for (const CompressedBlock& block : blocks) {
+        const uint64_t fields[] = { block.offset, block.compressedSize, block.rawSize, block.tokens, block.start };
+        for (uint64_t field : fields) out.append(buf, encodeVarint(buf, field));
+    }
+    for (int i = 0; i < 8; i++) out.push_back(static_cast<char>(indexOffset >> (8 * i)));
+    return out;
+}
+
+static bool opens(const std::string& stream) {
+    std::istringstream in(stream);
+    CompressedTokenReader reader(in);
+    return reader.open();
+}
+
+static bool readsAll(const std::string& stream) {
+    std::istringstream in(stream);
+    CompressedTokenReader reader(in);
+    return reader.open() && reader.read(0, reader.tokenCount(), [](TokenKind, uint64_t, uint64_t) {});
+}
+
+static void checkStream() {
+    // Three full blocks and part of a fourth, with gaps of up to 300 bytes
+    std::vector<Record> records;
+    uint64_t offset = 0;
+    for (size_t i = 0; i < 3 * COMPRESSED_BLOCK_TOKENS + 1234; i++) {
+        offset += rng() % 4 == 0 ? rng() % 300 : rng() % 3;
+        uint64_t length = 1 + rng() % 20;
+        records.push_back(Record{ static_cast<TokenKind>(rng() % static_cast<unsigned>(TokenKind::COUNT)), offset,
+                                  length });
+        offset += length;
+    }
+    std::string stream = writeStream(records);
+    std::istringstream in(stream);
+    CompressedTokenReader reader(in);
+    CHECK(reader.open());
+    CHECK_EQ(reader.tokenCount(), uint64_t(records.size()));
+    CHECK_EQ(reader.index().size(), size_t(4));
+
+    size_t mismatches = 0;
+    uint64_t next = 0;
+    CHECK(reader.read(0, records.size(), [&](TokenKind kind, uint64_t offset, uint64_t length) {
+        const Record& r = records[next++];
+        if (kind != r.kind || offset != r.offset || length != r.length) mismatches++;
+    }));
+    CHECK_EQ(next, uint64_t(records.size()));
+    CHECK_EQ(mismatches, size_t(0));
+
+    // Ranges that cross block boundaries, and ones that run off the end
+    for (uint64_t first : { uint64_t(0), COMPRESSED_BLOCK_TOKENS - 3, 2 * COMPRESSED_BLOCK_TOKENS - 1,
+                            uint64_t(records.size() - 2) }) {
+        uint64_t seen = first;
+        CHECK(reader.read(first, 7, [&](TokenKind kind, uint64_t offset, uint64_t) {
+            if (kind != records[seen].kind || offset != records[seen].offset) mismatches++;
+            seen++;
+        }));
+        CHECK_EQ(seen, std::min(first + 7, uint64_t(records.size())));
+    }
+    CHECK_EQ(mismatches, size_t(0));
+
+    // tokenAt() against a linear search, at random offsets and at the
+    // first and last bytes of the tokens next to each block boundary
+    std::vector<uint64_t> probes = { 0, offset - 1, offset, offset + 100 };
+    for (int i = 0; i < 2000; i++) probes.push_back(rng() % (offset + 1));
+    for (uint64_t b = 1; b < 4; b++) {
+        for (uint64_t t = b * COMPRESSED_BLOCK_TOKENS - 2; t < b * COMPRESSED_BLOCK_TOKENS + 2; t++) {
+            probes.push_back(records[t].offset);
+            probes.push_back(records[t].offset + records[t].length - 1);
+            probes.push_back(records[t].offset + records[t].length);
+            if (records[t].offset > 0) probes.push_back(records[t].offset - 1);
+        }
+    }
+    for (uint64_t probe : probes) {
+        uint64_t want = records.size();
+        for (size_t i = 0; i < records.size(); i++) {
+            if (records[i].offset + records[i].length > probe) {
+                want = i;
+                break;
+            }
+        }
+        CHECK_EQ(reader.tokenAt(probe), want);
+    }
+
+    // An empty stream has no blocks
+    std::string empty = writeStream({});
+    std::istringstream emptyIn(empty);
+    CompressedTokenReader emptyReader(emptyIn);
+    CHECK(emptyReader.open());
+    CHECK_EQ(emptyReader.tokenCount(), uint64_t(0));
+    CHECK_EQ(emptyReader.tokenAt(0), uint64_t(0));
+
+    // Truncated streams lose the index
+    for (size_t cut : { size_t(0), size_t(4), size_t(5), size_t(13), stream.size() / 2, stream.size() - 1 }) {
+        CHECK(!opens(stream.substr(0, cut)));
+    }
+    std::string badMagic = stream;
+    badMagic[1] = 'X';
+    CHECK(!opens(badMagic));
+    std::string badOffset = stream;
+    badOffset[badOffset.size() - 1] = '\x7f';
+    CHECK(!opens(badOffset));
+
+    // Index sizes that do not fit the file are refused before anything is
+    // allocated for them
+    std::vector<CompressedBlock> index = reader.index();
+    CHECK(opens(withIndex(stream, index)));
+    auto damagedIndex = [&](size_t b, uint64_t CompressedBlock::*field, uint64_t value) {
+        std::vector<CompressedBlock> damaged = index;
+        damaged[b].*field = value;
+        return withIndex(stream, damaged);
+    };
+    CHECK(!opens(damagedIndex(1, &CompressedBlock::rawSize, uint64_t(1) << 60)));
+    CHECK(!opens(damagedIndex(1, &CompressedBlock::compressedSize, uint64_t(1) << 60)));
+    CHECK(!opens(damagedIndex(1, &CompressedBlock::compressedSize, index[1].compressedSize - 1)));
+    CHECK(!opens(damagedIndex(2, &CompressedBlock::offset, index[2].offset + 1)));
+    CHECK(!opens(damagedIndex(3, &CompressedBlock::tokens, uint64_t(1) << 60)));
+    CHECK(!opens(withIndex(stream, std::vector<CompressedBlock>(index.begin(), index.end() - 1))));
+
+    // Sizes that fit but are wrong, and damaged block bytes, fail the read
+    CHECK(!readsAll(damagedIndex(0, &CompressedBlock::rawSize, index[0].rawSize + 1)));
+    CHECK(!readsAll(damagedIndex(0, &CompressedBlock::tokens, index[0].tokens - 1)));
+    std::string zeroed = stream;
+    for (uint64_t i = 0; i < index[2].compressedSize; i++) zeroed[index[2].offset + i] = '\0';
+    CHECK(opens(zeroed));
+    CHECK(!readsAll(zeroed));
+    std::istringstream zeroedIn(zeroed);
+    CompressedTokenReader zeroedReader(zeroedIn);
+    CHECK(zeroedReader.open());
+    CHECK(zeroedReader.read(0, COMPRESSED_BLOCK_TOKENS, [](TokenKind, uint64_t, uint64_t) {}));
+    CHECK(!zeroedReader.read(2 * COMPRESSED_BLOCK_TOKENS, 1, [](TokenKind, uint64_t, uint64_t) {}));
+}
+
+int main() {
+    checkCodec();
+    checkStream();
+    return testStatus();
+}
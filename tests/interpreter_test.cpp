@@ -0,0 +1,540 @@
+// Every opcode, run in the interpreter against known results: integer
+// and real arithmetic at their edges, comparisons with NaN, loops, calls,
+// printing, records, arrays laid out inline and field by field, and the
+// runtime errors with the instruction that raised them.
+//
+// Each case runs again in tiered mode with every routine compiled by
+// TemplateJit on its first call, which must do exactly what the
+// interpreter did, and testTierUp() moves routines to native code in the
+// middle of a loop and at a call.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "bytecode.h"
+#include "check.h"
+#include "interpreter.h"
+#include "jit.h"
+
+#if defined(__x86_64__) && defined(__unix__)
+const bool HAVE_JIT = true;
+#else
+const bool HAVE_JIT = false; // TemplateJit compiles nothing
+#endif
+
+struct Outcome {
+    bool ok;
+    Value result;
+    std::string output;
+    RuntimeError error;
+    size_t nativeRoutines;
+};
+
+static Routine& addRoutine(Program& program, uint32_t params) {
+    program.routines.emplace_back();
+    program.routines.back().name = "r" + std::to_string(program.routines.size() - 1);
+    program.routines.back().params = params;
+    return program.routines.back();
+}
+
+// Runs routine entry, interpreted only, or in tiered mode with jit
+static Outcome interpret(const Program& program, const std::vector<Value>& args, NativeCompiler* jit = nullptr,
+                         uint32_t threshold = 1, uint32_t entry = 0) {
+    std::ostringstream out;
+    Interpreter interpreter(program, out);
+    if (jit) interpreter.setTierUp(jit, threshold);
+    Outcome outcome{ false, Value{ 0 }, std::string(), RuntimeError(), 0 };
+    outcome.ok = interpreter.run(entry, args.data(), outcome.result);
+    outcome.output = out.str();
+    if (!outcome.ok) outcome.error = interpreter.error();
+    outcome.nativeRoutines = interpreter.nativeRoutines();
+    return outcome;
+}
+
+static std::string describe(const Outcome& outcome) {
+    if (!outcome.ok) {
+        return outcome.error.message + " at " + std::to_string(outcome.error.routine) + ":"
+               + std::to_string(outcome.error.pc);
+    }
+    std::ostringstream text;
+    text << outcome.result.i << " (" << outcome.result.r << ")";
+    if (!outcome.output.empty()) text << " printing " << outcome.output.size() << " bytes";
+    return text.str();
+}
+
+static bool same(const Outcome& x, const Outcome& y) {
+    if (x.ok != y.ok || x.output != y.output) return false;
+    if (x.ok) return x.result.i == y.result.i;
+    return x.error.routine == y.error.routine && x.error.pc == y.error.pc && x.error.message == y.error.message;
+}
+
+static void expectSame(const std::string& name, const Outcome& got, const Outcome& want) {
+    if (!same(got, want)) {
+        std::cerr << name << ": tiered mode gives " << describe(got) << ", interpreter " << describe(want)
+                  << std::endl;
+        testFailures()++;
+    }
+}
+
+// Runs program in tiered mode from a routine that calls routine 0, so
+// every routine the JIT handles is native code from its first call
+static Outcome tiered(const Program& program, const std::vector<Value>& args) {
+    Program wrapped = program;
+    uint32_t params = program.routines[0].params;
+    Routine& entry = addRoutine(wrapped, params);
+    RoutineBuilder b(entry);
+    b.emit(Op::CALL, 0, 0, 0, 0);
+    b.emit(Op::RETURN, 0);
+    entry.registers = std::max(entry.registers, params);
+    TemplateJit jit;
+    return interpret(wrapped, args, &jit, 1, static_cast<uint32_t>(wrapped.routines.size() - 1));
+}
+
+static Value real(double value) {
+    Value v;
+    v.r = value;
+    return v;
+}
+
+// Results are compared bit for bit, so -0.0 is not 0.0
+static void expectResult(const std::string& name, const Program& program, const std::vector<Value>& args,
+                         Value expected, const std::string& output = std::string()) {
+    Outcome got = interpret(program, args);
+    if (!got.ok) {
+        std::cerr << name << ": failed with " << got.error.message << std::endl;
+        testFailures()++;
+    } else if (got.result.i != expected.i || got.output != output) {
+        std::cerr << name << ": gives " << got.result.i << " (" << got.result.r << "), expected " << expected.i
+                  << " (" << expected.r << ")" << std::endl;
+        testFailures()++;
+    }
+    expectSame(name, tiered(program, args), got);
+}
+
+static void expectError(const std::string& name, const Program& program, const std::vector<Value>& args,
+                        uint32_t routine, uint32_t pc, const std::string& message) {
+    Outcome got = interpret(program, args);
+    if (got.ok || got.error.routine != routine || got.error.pc != pc || got.error.message != message) {
+        std::cerr << name << ": expected \"" << message << "\" at " << routine << ":" << pc << ", got "
+                  << describe(got) << std::endl;
+        testFailures()++;
+    }
+    expectSame(name, tiered(program, args), got);
+}
+
+// return r0 op r1
+static Program binary(Op op) {
+    Program program;
+    RoutineBuilder b(addRoutine(program, 2));
+    b.emit(op, 2, 0, 1);
+    b.emit(Op::RETURN, 2);
+    return program;
+}
+
+// return op r0
+static Program unary(Op op) {
+    Program program;
+    RoutineBuilder b(addRoutine(program, 1));
+    b.emit(op, 1, 0);
+    b.emit(Op::RETURN, 1);
+    return program;
+}
+
+static std::string describe(Op op, Value x, Value y, bool isReal) {
+    std::ostringstream name;
+    name << opName(op) << "(";
+    if (isReal) name << x.r << ", " << y.r << ")";
+    else name << x.i << ", " << y.i << ")";
+    return name.str();
+}
+
+static void testIntegers() {
+    const int64_t MAX = INT64_MAX, MIN = INT64_MIN;
+    struct Case { Op op; int64_t x, y, expected; };
+    static const Case cases[] = {
+        { Op::ADD_I, MAX, 1, MIN }, { Op::SUB_I, MIN, 1, MAX }, { Op::MUL_I, MAX, 2, -2 },
+        { Op::MUL_I, -6, 7, -42 },
+        { Op::DIV_I, 7, 2, 3 }, { Op::DIV_I, -7, 2, -3 }, { Op::DIV_I, MIN, -1, MIN },
+        { Op::MOD_I, 7, 3, 1 }, { Op::MOD_I, -7, 3, -1 }, { Op::MOD_I, 7, -3, 1 }, { Op::MOD_I, MIN, -1, 0 },
+        { Op::EQ_I, 3, 3, 1 }, { Op::EQ_I, 3, 4, 0 }, { Op::NE_I, 3, 3, 0 }, { Op::NE_I, MIN, MAX, 1 },
+        { Op::LT_I, -1, 0, 1 }, { Op::LT_I, 0, 0, 0 }, { Op::LE_I, 0, 0, 1 }, { Op::LE_I, 1, 0, 0 },
+        { Op::AND, 1, 0, 0 }, { Op::AND, 1, 1, 1 }, { Op::OR, 0, 0, 0 }, { Op::OR, 1, 0, 1 },
+        { Op::XOR, 1, 1, 0 }, { Op::XOR, 0, 1, 1 },
+    };
+    for (const Case& c : cases) {
+        expectResult(describe(c.op, Value{ c.x }, Value{ c.y }, false), binary(c.op), { Value{ c.x }, Value{ c.y } },
+                     Value{ c.expected });
+    }
+    expectError("DIV_I by zero", binary(Op::DIV_I), { Value{ 1 }, Value{ 0 } }, 0, 0, "division by zero");
+    expectError("MOD_I by zero", binary(Op::MOD_I), { Value{ 1 }, Value{ 0 } }, 0, 0, "division by zero");
+
+    expectResult("NEG_I(5)", unary(Op::NEG_I), { Value{ 5 } }, Value{ -5 });
+    expectResult("NEG_I(MIN)", unary(Op::NEG_I), { Value{ MIN } }, Value{ MIN });
+    expectResult("NOT(1)", unary(Op::NOT), { Value{ 1 } }, Value{ 0 });
+    expectResult("NOT(0)", unary(Op::NOT), { Value{ 0 } }, Value{ 1 });
+    expectResult("MOVE", unary(Op::MOVE), { Value{ MIN } }, Value{ MIN });
+
+    Program loads;
+    loads.constants = { Value{ MAX }, real(0.5) };
+    RoutineBuilder b(addRoutine(loads, 0));
+    b.emit(Op::LOAD_INT, 0, 0, 0, -7);
+    b.emit(Op::LOAD_CONST, 1, 0, 0, 0);
+    b.emit(Op::ADD_I, 0, 0, 1); // MAX - 7
+    b.emit(Op::RETURN, 0);
+    expectResult("LOAD_INT and LOAD_CONST", loads, {}, Value{ MAX - 7 });
+}
+
+static void testReals() {
+    const double INF = std::numeric_limits<double>::infinity();
+    struct Case { Op op; double x, y, expected; };
+    static const Case cases[] = {
+        { Op::ADD_R, 1.5, 2.25, 3.75 }, { Op::SUB_R, 1.5, 2.25, -0.75 }, { Op::MUL_R, -1.5, 4, -6 },
+        { Op::DIV_R, 1, 8, 0.125 }, { Op::DIV_R, 1, 0, INF }, { Op::DIV_R, -1, 0, -INF },
+    };
+    for (const Case& c : cases) {
+        expectResult(describe(c.op, real(c.x), real(c.y), true), binary(c.op), { real(c.x), real(c.y) },
+                     real(c.expected));
+    }
+    Outcome nan = interpret(binary(Op::DIV_R), { real(0), real(0) });
+    CHECK(nan.ok && std::isnan(nan.result.r));
+    expectSame("DIV_R(0, 0)", tiered(binary(Op::DIV_R), { real(0), real(0) }), nan);
+
+    expectResult("NEG_R(0)", unary(Op::NEG_R), { real(0) }, real(-0.0));
+    expectResult("NEG_R(-2.5)", unary(Op::NEG_R), { real(-2.5) }, real(2.5));
+    expectResult("INT_TO_REAL(-3)", unary(Op::INT_TO_REAL), { Value{ -3 } }, real(-3));
+    expectResult("REAL_TO_INT(2.4)", unary(Op::REAL_TO_INT), { real(2.4) }, Value{ 2 });
+    expectResult("REAL_TO_INT(2.5)", unary(Op::REAL_TO_INT), { real(2.5) }, Value{ 3 });
+    expectResult("REAL_TO_INT(-2.5)", unary(Op::REAL_TO_INT), { real(-2.5) }, Value{ -3 });
+
+    // Every comparison with NaN is false, except /=
+    const double NaN = std::numeric_limits<double>::quiet_NaN();
+    struct Comparison { double x, y; int64_t eq, ne, lt, le; };
+    static const Comparison comparisons[] = {
+        { 1, 2, 0, 1, 1, 1 }, { 2, 2, 1, 0, 0, 1 }, { 2, 1, 0, 1, 0, 0 }, { -0.0, 0, 1, 0, 0, 1 },
+        { NaN, 1, 0, 1, 0, 0 }, { 1, NaN, 0, 1, 0, 0 }, { NaN, NaN, 0, 1, 0, 0 }, { -INF, INF, 0, 1, 1, 1 },
+    };
+    for (const Comparison& c : comparisons) {
+        const std::pair<Op, int64_t> expected[] = {
+            { Op::EQ_R, c.eq }, { Op::NE_R, c.ne }, { Op::LT_R, c.lt }, { Op::LE_R, c.le }
+        };
+        for (const std::pair<Op, int64_t>& e : expected) {
+            expectResult(describe(e.first, real(c.x), real(c.y), true), binary(e.first), { real(c.x), real(c.y) },
+                         Value{ e.second });
+        }
+    }
+}
+
+// result := 0; for i in [reverse] r0..r1 loop result := result * 10 + i end
+static Program digits(bool reverse) {
+    Program program;
+    RoutineBuilder b(addRoutine(program, 2));
+    b.emit(Op::LOAD_INT, 2, 0, 0, 0);
+    b.emit(Op::LOAD_INT, 5, 0, 0, 10);
+    b.emit(Op::MOVE, 3, reverse ? 1 : 0);
+    b.emit(Op::MOVE, 4, reverse ? 0 : 1);
+    size_t prep = b.emit(reverse ? Op::FOR_PREP_REV : Op::FOR_PREP, 3);
+    size_t body = b.here();
+    b.emit(Op::MUL_I, 2, 2, 5);
+    b.emit(Op::ADD_I, 2, 2, 3);
+    b.jumpTo(reverse ? Op::FOR_LOOP_REV : Op::FOR_LOOP, 3, body);
+    b.patch(prep, b.here());
+    b.emit(Op::RETURN, 2);
+    return program;
+}
+
+// while r0 /= r1 loop if r0 < r1 then r1 -= r0 else r0 -= r1 end end
+static Program gcd() {
+    Program program;
+    RoutineBuilder b(addRoutine(program, 2));
+    size_t top = b.here();
+    b.emit(Op::NE_I, 2, 0, 1);
+    size_t exit = b.emit(Op::JUMP_IF_FALSE, 2);
+    b.emit(Op::LT_I, 2, 0, 1);
+    size_t less = b.emit(Op::JUMP_IF_TRUE, 2);
+    b.emit(Op::SUB_I, 0, 0, 1);
+    b.jumpTo(Op::JUMP, 0, top);
+    b.patch(less, b.here());
+    b.emit(Op::SUB_I, 1, 1, 0);
+    b.jumpTo(Op::JUMP, 0, top);
+    b.patch(exit, b.here());
+    b.emit(Op::RETURN, 0);
+    return program;
+}
+
+static void testControlFlow() {
+    expectResult("for 1..3", digits(false), { Value{ 1 }, Value{ 3 } }, Value{ 123 });
+    expectResult("for 3..3", digits(false), { Value{ 3 }, Value{ 3 } }, Value{ 3 });
+    expectResult("for 4..3", digits(false), { Value{ 4 }, Value{ 3 } }, Value{ 0 });
+    expectResult("for reverse 1..3", digits(true), { Value{ 1 }, Value{ 3 } }, Value{ 321 });
+    expectResult("for reverse 4..3", digits(true), { Value{ 4 }, Value{ 3 } }, Value{ 0 });
+    expectResult("gcd(12, 18)", gcd(), { Value{ 12 }, Value{ 18 } }, Value{ 6 });
+    expectResult("gcd(7, 7)", gcd(), { Value{ 7 }, Value{ 7 } }, Value{ 7 });
+    expectResult("gcd(35, 14)", gcd(), { Value{ 35 }, Value{ 14 } }, Value{ 7 });
+}
+
+// Recursive fib, and a routine without a result that prints its arguments
+static Program calls() {
+    Program program;
+    RoutineBuilder fib(addRoutine(program, 1));
+    fib.emit(Op::LOAD_INT, 2, 0, 0, 2);
+    fib.emit(Op::LT_I, 1, 0, 2);
+    size_t recurse = fib.emit(Op::JUMP_IF_FALSE, 1);
+    fib.emit(Op::RETURN, 0);
+    fib.patch(recurse, fib.here());
+    fib.emit(Op::LOAD_INT, 3, 0, 0, 1);
+    fib.emit(Op::SUB_I, 4, 0, 3);
+    fib.emit(Op::CALL, 4, 0, 0, 0);
+    fib.emit(Op::SUB_I, 5, 0, 2);
+    fib.emit(Op::CALL, 5, 0, 0, 0);
+    fib.emit(Op::ADD_I, 4, 4, 5);
+    fib.emit(Op::RETURN, 4);
+    return program;
+}
+
+static void testCalls() {
+    Program program = calls();
+    expectResult("fib(1)", program, { Value{ 1 } }, Value{ 1 });
+    expectResult("fib(20)", program, { Value{ 20 } }, Value{ 6765 });
+
+    Program printing;
+    RoutineBuilder main(addRoutine(printing, 1));
+    main.emit(Op::MOVE, 2, 0);
+    main.emit(Op::INT_TO_REAL, 3, 0);
+    main.emit(Op::LOAD_INT, 4, 0, 0, 1);
+    main.emit(Op::LOAD_INT, 5, 0, 0, 0);
+    main.emit(Op::CALL, 2, 0, 0, 1);
+    main.emit(Op::RETURN, 0); // r0 is below the callee's window
+    RoutineBuilder print(addRoutine(printing, 4));
+    print.emit(Op::PRINT_I, 0);
+    print.emit(Op::PRINT_R, 1);
+    print.emit(Op::PRINT_B, 2);
+    print.emit(Op::PRINT_B, 3);
+    print.emit(Op::RETURN_NONE);
+    print.emit(Op::PRINT_I, 0); // not reached
+    expectResult("PRINT", printing, { Value{ -4 } }, Value{ -4 }, "-4\n-4\ntrue\nfalse\n");
+}
+
+// A record filled, copied and read back
+static Program records() {
+    Program program;
+    RoutineBuilder b(addRoutine(program, 1));
+    b.emit(Op::NEW_RECORD, 1, 0, 0, 2);
+    b.emit(Op::STORE, 1, 0, 0, 1);
+    b.emit(Op::NEW_RECORD, 2, 0, 0, 2);
+    b.emit(Op::COPY, 2, 1, 0, 2);
+    b.emit(Op::STORE, 1, 1, 0, 1); // the copy keeps its own slots
+    b.emit(Op::LOAD, 3, 2, 0, 1);
+    b.emit(Op::RETURN, 3);
+    return program;
+}
+
+// Routine 0 makes an array of r0 two-field records and passes it to
+// routine 1, which sets field 0 of element i to i and field 1 to i * i
+// through checked INDEX or INDEX_SOA, then returns the length plus the
+// sum of the products of the fields read through the unchecked form.
+static Program arrays(bool soa) {
+    Program program;
+    RoutineBuilder main(addRoutine(program, 1));
+    main.emit(Op::NEW_ARRAY, 1, 0, 0, 2);
+    main.emit(Op::CALL, 1, 0, 0, 1);
+    main.emit(Op::RETURN, 1);
+
+    Op checked = soa ? Op::INDEX_SOA : Op::INDEX;
+    Op unchecked = soa ? Op::INDEX_SOA_UNCHECKED : Op::INDEX_UNCHECKED;
+    RoutineBuilder b(addRoutine(program, 1));
+    b.emit(Op::LENGTH, 1, 0);
+    b.emit(Op::MOVE, 8, 1); // the result
+    for (int pass = 0; pass < 2; pass++) {
+        b.emit(Op::LOAD_INT, 2, 0, 0, 1);
+        b.emit(Op::MOVE, 3, 1);
+        size_t prep = b.emit(Op::FOR_PREP, 2);
+        size_t body = b.here();
+        Op index = pass == 0 ? checked : unchecked;
+        // r4 and r5 address the fields
+        if (soa) {
+            b.emit(index, 4, 0, 2, 0);
+            b.emit(index, 5, 0, 2, 1);
+        } else {
+            b.emit(index, 4, 0, 2, 2);
+            b.emit(Op::MOVE, 5, 4);
+        }
+        int32_t second = soa ? 0 : 1;
+        if (pass == 0) {
+            b.emit(Op::MUL_I, 6, 2, 2);
+            b.emit(Op::STORE, 4, 2, 0, 0);
+            b.emit(Op::STORE, 5, 6, 0, second);
+        } else {
+            b.emit(Op::LOAD, 6, 4, 0, 0);
+            b.emit(Op::LOAD, 7, 5, 0, second);
+            b.emit(Op::MUL_I, 6, 6, 7);
+            b.emit(Op::ADD_I, 8, 8, 6);
+        }
+        b.jumpTo(Op::FOR_LOOP, 2, body);
+        b.patch(prep, b.here());
+    }
+    b.emit(Op::RETURN, 8);
+    return program;
+}
+
+// Routine 0 makes an array of r0 elements and routine 1 reads element r1
+static Program lookup(bool soa) {
+    Program program;
+    RoutineBuilder main(addRoutine(program, 2));
+    main.emit(Op::NEW_ARRAY, 2, 0, 0, soa ? 2 : 1);
+    main.emit(Op::MOVE, 3, 1);
+    main.emit(Op::CALL, 2, 0, 0, 1);
+    main.emit(Op::RETURN, 2);
+    RoutineBuilder b(addRoutine(program, 2));
+    b.emit(Op::LOAD_INT, 3, 0, 0, 5);
+    b.emit(soa ? Op::INDEX_SOA : Op::INDEX, 2, 0, 1, 1); // one slot, or field 1 of 2
+    b.emit(Op::LOAD, 2, 2);
+    b.emit(Op::ADD_I, 2, 2, 3);
+    b.emit(Op::RETURN, 2);
+    return program;
+}
+
+static void testHeap() {
+    expectResult("records", records(), { Value{ 9 } }, Value{ 9 });
+
+    for (bool soa : { false, true }) {
+        std::string layout = soa ? "by-field " : "inline ";
+        expectResult(layout + "array of 4", arrays(soa), { Value{ 4 } }, Value{ 4 + 1 + 8 + 27 + 64 });
+        expectResult(layout + "array of 1", arrays(soa), { Value{ 1 } }, Value{ 2 });
+        expectResult(layout + "array of 0", arrays(soa), { Value{ 0 } }, Value{ 0 });
+
+        Program program = lookup(soa);
+        expectResult(layout + "element 1 of 3", program, { Value{ 3 }, Value{ 1 } }, Value{ 5 });
+        expectResult(layout + "element 3 of 3", program, { Value{ 3 }, Value{ 3 } }, Value{ 5 });
+        for (int64_t index : { INT64_MIN, int64_t(-1), int64_t(0), int64_t(4), INT64_MAX }) {
+            expectError(layout + "element " + std::to_string(index) + " of 3", program, { Value{ 3 }, Value{ index } },
+                        1, 1, "array index out of range");
+        }
+        expectError(layout + "element 1 of 0", program, { Value{ 0 }, Value{ 1 } }, 1, 1, "array index out of range");
+        expectError(layout + "array of -1", program, { Value{ -1 }, Value{ 1 } }, 0, 0, "negative array size");
+    }
+}
+
+// Routines compiled in tiered mode: only those without calls, division,
+// allocation, rounding or printing
+static void testCompiled() {
+    size_t one = HAVE_JIT ? 1 : 0;
+    CHECK_EQ(tiered(binary(Op::ADD_R), { real(1), real(2) }).nativeRoutines, one);
+    CHECK_EQ(tiered(binary(Op::LT_R), { real(1), real(2) }).nativeRoutines, one);
+    CHECK_EQ(tiered(gcd(), { Value{ 12 }, Value{ 18 } }).nativeRoutines, one);
+    CHECK_EQ(tiered(digits(true), { Value{ 1 }, Value{ 3 } }).nativeRoutines, one);
+    CHECK_EQ(tiered(arrays(true), { Value{ 4 } }).nativeRoutines, one);
+    CHECK_EQ(tiered(lookup(false), { Value{ 3 }, Value{ 4 } }).nativeRoutines, one);
+    CHECK_EQ(tiered(binary(Op::DIV_I), { Value{ 1 }, Value{ 2 } }).nativeRoutines, size_t(0));
+    CHECK_EQ(tiered(unary(Op::REAL_TO_INT), { real(1) }).nativeRoutines, size_t(0));
+    CHECK_EQ(tiered(calls(), { Value{ 5 } }).nativeRoutines, size_t(0));
+}
+
+// Runs program interpreted only and with tier-up at threshold, checks both
+// do the same, and returns the number of routines compiled
+static size_t tierUp(const std::string& name, const Program& program, const std::vector<Value>& args,
+                     uint32_t threshold) {
+    TemplateJit jit;
+    Outcome got = interpret(program, args, &jit, threshold);
+    expectSame(name, got, interpret(program, args));
+    return got.nativeRoutines;
+}
+
+// Routine 0 calls routine 1, the routine of callee, with r0 and r1,
+// prints the result and returns it plus r0
+static Program caller(const Program& callee) {
+    Program program;
+    RoutineBuilder main(addRoutine(program, 2));
+    main.emit(Op::MOVE, 2, 0);
+    main.emit(Op::MOVE, 3, 1);
+    main.emit(Op::CALL, 2, 0, 0, 1);
+    main.emit(Op::PRINT_I, 2);
+    main.emit(Op::ADD_I, 2, 2, 0);
+    main.emit(Op::RETURN, 2);
+    program.routines.push_back(callee.routines[0]);
+    return program;
+}
+
+// Routine 0 sums routine 1, which squares its argument, over 1..r0
+static Program squares() {
+    Program program;
+    RoutineBuilder main(addRoutine(program, 1));
+    main.emit(Op::LOAD_INT, 1, 0, 0, 0);
+    main.emit(Op::LOAD_INT, 2, 0, 0, 1);
+    main.emit(Op::MOVE, 3, 0);
+    size_t prep = main.emit(Op::FOR_PREP, 2);
+    size_t body = main.here();
+    main.emit(Op::MOVE, 4, 2);
+    main.emit(Op::CALL, 4, 0, 0, 1);
+    main.emit(Op::ADD_I, 1, 1, 4);
+    main.jumpTo(Op::FOR_LOOP, 2, body);
+    main.patch(prep, main.here());
+    main.emit(Op::RETURN, 1);
+    RoutineBuilder square(addRoutine(program, 1));
+    square.emit(Op::MUL_I, 0, 0, 0);
+    square.emit(Op::RETURN, 0);
+    return program;
+}
+
+// Routine 0 makes an array of r0 elements, routine 1 sums elements
+// 1..r1 of it
+static Program sumElements() {
+    Program program;
+    RoutineBuilder main(addRoutine(program, 2));
+    main.emit(Op::NEW_ARRAY, 2, 0, 0, 1);
+    main.emit(Op::MOVE, 3, 1);
+    main.emit(Op::CALL, 2, 0, 0, 1);
+    main.emit(Op::RETURN, 2);
+    RoutineBuilder b(addRoutine(program, 2));
+    b.emit(Op::LOAD_INT, 2, 0, 0, 1);
+    b.emit(Op::MOVE, 3, 1);
+    b.emit(Op::LOAD_INT, 5, 0, 0, 0);
+    size_t prep = b.emit(Op::FOR_PREP, 2);
+    size_t body = b.here();
+    b.emit(Op::INDEX, 4, 0, 2, 1);
+    b.emit(Op::STORE, 4, 2);
+    b.emit(Op::LOAD, 4, 4);
+    b.emit(Op::ADD_I, 5, 5, 4);
+    b.jumpTo(Op::FOR_LOOP, 2, body);
+    b.patch(prep, b.here());
+    b.emit(Op::RETURN, 5);
+    return program;
+}
+
+static void testTierUp() {
+    size_t one = HAVE_JIT ? 1 : 0;
+    // At a taken backward jump, in the routine run() was called with
+    CHECK_EQ(tierUp("gcd(1, 100000)", gcd(), { Value{ 1 }, Value{ 100000 } }, 50), one);
+    CHECK_EQ(tierUp("gcd(100000, 3)", gcd(), { Value{ 100000 }, Value{ 3 } }, 2), one);
+    CHECK_EQ(tierUp("gcd(12, 18)", gcd(), { Value{ 12 }, Value{ 18 } }, 50), size_t(0));
+    // At FOR_LOOP and FOR_LOOP_REV, in the middle of the loop
+    CHECK_EQ(tierUp("for 1..9", digits(false), { Value{ 1 }, Value{ 9 } }, 4), one);
+    CHECK_EQ(tierUp("for reverse 1..9", digits(true), { Value{ 1 }, Value{ 9 } }, 4), one);
+    CHECK_EQ(tierUp("for 1..9, last iteration", digits(false), { Value{ 1 }, Value{ 9 } }, 8), one);
+    // In a callee, which then returns to its interpreted caller
+    CHECK_EQ(tierUp("call of for 1..9", caller(digits(false)), { Value{ 1 }, Value{ 9 } }, 5), one);
+    CHECK_EQ(tierUp("call of gcd", caller(gcd()), { Value{ 30 }, Value{ 1000 } }, 10), one);
+    // At CALL: the callee runs natively from its third call
+    CHECK_EQ(tierUp("squares 1..10", squares(), { Value{ 10 } }, 3), one);
+    CHECK_EQ(tierUp("squares 1..2", squares(), { Value{ 2 } }, 3), size_t(0));
+    // A failed bounds check in code compiled at a backward jump
+    CHECK_EQ(tierUp("elements 1..10 of 10", sumElements(), { Value{ 10 }, Value{ 10 } }, 3), one);
+    CHECK_EQ(tierUp("elements 1..11 of 10", sumElements(), { Value{ 10 }, Value{ 11 } }, 3), one);
+    Outcome outOfRange = interpret(sumElements(), { Value{ 10 }, Value{ 11 } });
+    CHECK(!outOfRange.ok && outOfRange.error.routine == 1 && outOfRange.error.pc == 4);
+}
+
+int main() {
+    testIntegers();
+    testReals();
+    testControlFlow();
+    testCalls();
+    testHeap();
+    testCompiled();
+    testTierUp();
+    return testStatus();
+}
@@ -0,0 +1,106 @@
+#!/bin/sh
+# Lexer::LexerInput() cuts whitespace and comments down one refill at a
+# time. This builds the lexer with refills of a few bytes
+# (-DLEXER_REFILL_SIZE) and checks inputs whose whitespace runs, comments
+# and '/' bytes fall on every refill boundary and at the end of the input
+# against the plain rules of bench/reference.l: istream and --mmap input,
+# both formats, and --batch, which restarts one scanner for every file.
+set -e
+
+SIZES="1 2 3 5 16"
+
+sh "$ROOT/bench/literal_keywords.sh" "$ROOT/bench/reference.l" "$WORK/reference.l"
+$FLEX -o "$WORK/reference.yy.cc" "$WORK/reference.l"
+# shellcheck disable=SC2086
+$CXX $CXXFLAGS -I"$ROOT" "$WORK/reference.yy.cc" -o "$WORK/reference"
+$FLEX -o "$WORK/lex.yy.cc" "$ROOT/lexer.l"
+lexers=""
+for size in $SIZES; do
+    # shellcheck disable=SC2086
+    $CXX $CXXFLAGS -DLEXER_REFILL_SIZE=$size -I"$ROOT" "$WORK/lex.yy.cc" -o "$WORK/lexer-$size"
+    lexers="$lexers lexer-$size"
+done
+# shellcheck disable=SC2086
+$CXX $CXXFLAGS -DLEXER_REFILL_SIZE=3 -DLEXER_NO_SIMD -I"$ROOT" "$WORK/lex.yy.cc" -o "$WORK/lexer-3-scalar"
+lexers="$lexers lexer-3-scalar"
+
+mkdir -p "$WORK/inputs" "$WORK/want"
+count=0
+add() {
+    count=$((count + 1))
+    printf '%b' "$1" > "$WORK/inputs/$(printf '%03d' $count).i"
+}
+repeat() {
+    i=0
+    while [ $i -lt "$2" ]; do printf '%s' "$1"; i=$((i + 1)); done
+}
+
+add ''
+add ' '
+add '\n\n\n'
+add '/'
+add '//'
+add 'a/'
+add 'a /'
+add 'a//'
+add 'a //'
+add '// only a comment'
+add 'x // comment at the end'
+add 'x // comment\n'
+add '/=/ //=\n/ /=// /\n'
+add 'a/b/ c / d//e\n/f'
+add '\t \r\n  // one\n   // two\n\n\tb'
+add 'var x : integer := 1; // set x\r\n  x := x / 2 // halve\r\n'
+add '$  $//@\n@ # //\n\n#'
+add '  leading and trailing  \n\n  '
+add '1.5  ..2 // c\n3..4 1.  .5'
+for k in 0 1 2 3 4 5 7 8 15 16 17 31 32 33 40; do
+    s=$(repeat ' ' $k)
+    add "${s}a${s}//$(repeat x $k)\n${s}b /c${s}/\n$(repeat '\t' $k)/"
+    add "$(repeat 'ab ' $k)//$(repeat '/' $k)\n$(repeat '/ ' $k)$(repeat '\n' $k)z"
+done
+
+failures=0
+fail() {
+    echo "$1" >&2
+    failures=$((failures + 1))
+}
+
+# run <lexer> <format> <mode> <input> <output>: prints the exit status and
+# keeps the error lines
+run() {
+    status=0
+    # shellcheck disable=SC2086
+    "$WORK/$1" --recover --max-errors=1000 --format="$2" $3 "$4" "$5" 2> "$5.stderr" > /dev/null || status=$?
+    grep ': error: ' "$5.stderr" > "$5.errors" || true
+    echo "$status"
+}
+
+for input in "$WORK"/inputs/*.i; do
+    name=$(basename "$input")
+    for format in text binary; do
+        want=$(run reference $format "" "$input" "$WORK/want.out")
+        [ $format = binary ] && cp "$WORK/want.out" "$WORK/want/$name.tok"
+        for lexer in $lexers; do
+            for mode in "" --mmap; do
+                got=$(run "$lexer" $format "$mode" "$input" "$WORK/got.out")
+                if [ "$got" != "$want" ] || ! cmp -s "$WORK/want.out" "$WORK/got.out" \
+                    || ! cmp -s "$WORK/want.out.errors" "$WORK/got.out.errors"; then
+                    fail "$name: $lexer --format=$format $mode differs from the reference"
+                fi
+            done
+        done
+    done
+done
+
+for lexer in $lexers; do
+    "$WORK/$lexer" --batch --recover --format=binary "$WORK/inputs" "$WORK/batch-$lexer" > /dev/null 2>&1 || true
+    for input in "$WORK"/inputs/*.i; do
+        name=$(basename "$input")
+        cmp -s "$WORK/want/$name.tok" "$WORK/batch-$lexer/$name.tok" \
+            || fail "$name: $lexer --batch differs from the reference"
+    done
+done
+
+echo "$count inputs, $failures differences"
+[ $failures -eq 0 ]
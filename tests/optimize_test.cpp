@@ -0,0 +1,361 @@
+// The optimizer must not change what a routine does: every case runs the
+// original and the optimized program in the interpreter and compares the
+// result, the printed output and any runtime error.
+
+#include <cstdint>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "bytecode.h"
+#include "check.h"
+#include "interpreter.h"
+#include "optimize.h"
+
+struct Outcome {
+    bool ok;
+    int64_t result;
+    std::string output;
+    std::string error;
+};
+
+static Outcome runProgram(const Program& program, const std::vector<Value>& args) {
+    std::ostringstream out;
+    Interpreter interpreter(program, out);
+    Value result{ 0 };
+    bool ok = interpreter.run(0, args.data(), result);
+    return Outcome{ ok, ok ? result.i : 0, out.str(), ok ? std::string() : interpreter.error().message };
+}
+
+// Optimizes a copy of program and checks it against the original for each
+// argument list. Returns the optimizer's statistics.
+static OptimizeStats checkOptimized(const char* name, const Program& program,
+                                    const std::vector<std::vector<Value>>& argLists) {
+    Program optimized = program;
+    OptimizeStats stats = optimizeProgram(optimized);
+    for (const std::vector<Value>& args : argLists) {
+        Outcome want = runProgram(program, args);
+        Outcome got = runProgram(optimized, args);
+        if (got.ok != want.ok || got.result != want.result || got.output != want.output || got.error != want.error) {
+            std::cerr << name << "(" << (args.empty() ? 0 : args[0].i) << "): optimized code gives "
+                      << (got.ok ? std::to_string(got.result) : got.error) << ", original "
+                      << (want.ok ? std::to_string(want.result) : want.error) << std::endl;
+            testFailures()++;
+        }
+    }
+    return stats;
+}
+
+static std::vector<std::vector<Value>> intArgs(std::initializer_list<int64_t> values) {
+    std::vector<std::vector<Value>> lists;
+    for (int64_t value : values) lists.push_back({ Value{ value } });
+    return lists;
+}
+
+static Routine& addRoutine(Program& program, uint32_t params) {
+    program.routines.emplace_back();
+    program.routines.back().name = "r" + std::to_string(program.routines.size() - 1);
+    program.routines.back().params = params;
+    return program.routines.back();
+}
+
+// flag := 1; y := 1; if x then y := 7 else if flag then end end; return y + y
+// The inner test is known not to jump and is removed. The code at the
+// join is reached both from it and from the jump at the end of the then
+// branch, so y is not known there.
+static void testRemovedJumpFallsThrough() {
+    Program program;
+    RoutineBuilder b(addRoutine(program, 1));
+    b.emit(Op::LOAD_INT, 1, 0, 0, 1);
+    b.emit(Op::LOAD_INT, 2, 0, 0, 1);
+    size_t toElse = b.emit(Op::JUMP_IF_FALSE, 0);
+    b.emit(Op::LOAD_INT, 2, 0, 0, 7);
+    size_t toEnd = b.emit(Op::JUMP);
+    b.patch(toElse, b.here());
+    size_t innerEnd = b.emit(Op::JUMP_IF_FALSE, 1);
+    b.patch(toEnd, b.here());
+    b.patch(innerEnd, b.here());
+    b.emit(Op::ADD_I, 3, 2, 2);
+    b.emit(Op::RETURN, 3);
+
+    OptimizeStats stats = checkOptimized("removed jump", program, intArgs({ 0, 1 }));
+    CHECK_EQ(stats.folded, uint64_t(1));
+}
+
+// The same with a loop whose entry test is decided: the FOR_PREP is
+// removed and the loop body follows it.
+static void testRemovedLoopTestFallsThrough() {
+    Program program;
+    RoutineBuilder b(addRoutine(program, 1));
+    b.emit(Op::LOAD_INT, 2, 0, 0, 1);
+    size_t toElse = b.emit(Op::JUMP_IF_FALSE, 0);
+    b.emit(Op::LOAD_INT, 2, 0, 0, 5);
+    size_t toLoop = b.emit(Op::JUMP);
+    b.patch(toElse, b.here());
+    b.patch(toLoop, b.here());
+    b.emit(Op::LOAD_INT, 4, 0, 0, 1);
+    b.emit(Op::LOAD_INT, 5, 0, 0, 3);
+    size_t prep = b.emit(Op::FOR_PREP, 4);
+    size_t body = b.here();
+    b.emit(Op::ADD_I, 2, 2, 4);
+    b.jumpTo(Op::FOR_LOOP, 4, body);
+    b.patch(prep, b.here());
+    b.emit(Op::RETURN, 2);
+
+    OptimizeStats stats = checkOptimized("removed loop test", program, intArgs({ 0, 1 }));
+    CHECK_EQ(stats.loopsSpecialized, uint64_t(1));
+}
+
+// Arithmetic with known operands folds, wrapping like the interpreter;
+// division by zero is left for it to report.
+static void testFolding() {
+    Program program;
+    program.constants.push_back(Value{ INT64_MAX });
+    program.constants.push_back(Value{ 0 });
+    program.constants.back().r = 2.5;
+    RoutineBuilder b(addRoutine(program, 1));
+    b.emit(Op::LOAD_CONST, 1, 0, 0, 0);
+    b.emit(Op::LOAD_INT, 2, 0, 0, 1);
+    b.emit(Op::ADD_I, 3, 1, 2); // wraps to INT64_MIN
+    b.emit(Op::LOAD_CONST, 4, 0, 0, 1);
+    b.emit(Op::MUL_R, 5, 4, 4);
+    b.emit(Op::REAL_TO_INT, 6, 5); // 6.25 rounds to 6
+    b.emit(Op::LT_I, 7, 3, 6);
+    b.emit(Op::NOT, 8, 7);
+    size_t skip = b.emit(Op::JUMP_IF_TRUE, 8); // not taken
+    b.emit(Op::ADD_I, 9, 3, 6);
+    b.emit(Op::PRINT_I, 9);
+    b.patch(skip, b.here());
+    size_t divide = b.emit(Op::JUMP_IF_FALSE, 0);
+    b.emit(Op::LOAD_INT, 10, 0, 0, 0);
+    b.emit(Op::DIV_I, 11, 6, 10);
+    b.patch(divide, b.here());
+    b.emit(Op::SUB_I, 12, 6, 2);
+    b.emit(Op::RETURN, 12);
+
+    OptimizeStats stats = checkOptimized("folding", program, intArgs({ 0, 1 }));
+    CHECK(stats.folded >= 6);
+}
+
+// var a : array [10] integer; for i in 1 .. 10 loop a[i] := i * i end;
+// then a reverse loop sums them and a constant index reads a[3] and a[11]
+// (the last one out of range, so it keeps its check).
+static void testBoundsChecks() {
+    Program program;
+    RoutineBuilder b(addRoutine(program, 1));
+    b.emit(Op::LOAD_INT, 1, 0, 0, 10);
+    b.emit(Op::NEW_ARRAY, 2, 1, 0, 1);
+    b.emit(Op::LOAD_INT, 4, 0, 0, 1);
+    b.emit(Op::MOVE, 5, 1);
+    size_t prep = b.emit(Op::FOR_PREP, 4);
+    size_t body = b.here();
+    b.emit(Op::INDEX, 6, 2, 4, 1);
+    b.emit(Op::MUL_I, 7, 4, 4);
+    b.emit(Op::STORE, 6, 7);
+    b.jumpTo(Op::FOR_LOOP, 4, body);
+    b.patch(prep, b.here());
+
+    b.emit(Op::LOAD_INT, 3, 0, 0, 0);
+    b.emit(Op::LENGTH, 8, 2);
+    b.emit(Op::LOAD_INT, 9, 0, 0, 1);
+    prep = b.emit(Op::FOR_PREP_REV, 8);
+    body = b.here();
+    b.emit(Op::INDEX, 6, 2, 8, 1);
+    b.emit(Op::LOAD, 7, 6);
+    b.emit(Op::ADD_I, 3, 3, 7);
+    b.jumpTo(Op::FOR_LOOP_REV, 8, body);
+    b.patch(prep, b.here());
+
+    b.emit(Op::LOAD_INT, 10, 0, 0, 3);
+    b.emit(Op::INDEX, 6, 2, 10, 1);
+    b.emit(Op::LOAD, 7, 6);
+    b.emit(Op::ADD_I, 3, 3, 7);
+    size_t skip = b.emit(Op::JUMP_IF_FALSE, 0);
+    b.emit(Op::LOAD_INT, 10, 0, 0, 11);
+    b.emit(Op::INDEX, 6, 2, 10, 1);
+    b.patch(skip, b.here());
+    b.emit(Op::RETURN, 3);
+
+    OptimizeStats stats = checkOptimized("bounds checks", program, intArgs({ 0, 1 }));
+    CHECK_EQ(stats.checksRemoved, uint64_t(3));
+    CHECK_EQ(stats.loopsSpecialized, uint64_t(2));
+}
+
+// By-field arrays: INDEX_SOA in a loop over the whole array
+static void testByFieldArray() {
+    Program program;
+    RoutineBuilder b(addRoutine(program, 1));
+    b.emit(Op::LOAD_INT, 1, 0, 0, 4);
+    b.emit(Op::NEW_ARRAY, 2, 1, 0, 2);
+    b.emit(Op::LOAD_INT, 3, 0, 0, 0);
+    b.emit(Op::LOAD_INT, 4, 0, 0, 1);
+    b.emit(Op::MOVE, 5, 0); // limit from the argument: not a known range
+    size_t prep = b.emit(Op::FOR_PREP, 4);
+    size_t body = b.here();
+    b.emit(Op::INDEX_SOA, 6, 2, 4, 1);
+    b.emit(Op::STORE, 6, 4);
+    b.emit(Op::LOAD, 7, 6);
+    b.emit(Op::ADD_I, 3, 3, 7);
+    b.jumpTo(Op::FOR_LOOP, 4, body);
+    b.patch(prep, b.here());
+    b.emit(Op::LOAD_INT, 5, 0, 0, 4);
+    b.emit(Op::LOAD_INT, 4, 0, 0, 1);
+    prep = b.emit(Op::FOR_PREP, 4);
+    body = b.here();
+    b.emit(Op::INDEX_SOA, 6, 2, 4, 0);
+    b.emit(Op::STORE, 6, 3);
+    b.jumpTo(Op::FOR_LOOP, 4, body);
+    b.patch(prep, b.here());
+    b.emit(Op::LOAD, 7, 6);
+    b.emit(Op::ADD_I, 3, 3, 7);
+    b.emit(Op::RETURN, 3);
+
+    OptimizeStats stats = checkOptimized("by-field array", program, intArgs({ 0, 2, 4, 5 }));
+    CHECK_EQ(stats.checksRemoved, uint64_t(1));
+}
+
+// A value changed in a loop body is not known after the loop, nor at the
+// top of the body on later iterations.
+static void testLoopCarriedValues() {
+    Program program;
+    RoutineBuilder b(addRoutine(program, 1));
+    b.emit(Op::LOAD_INT, 1, 0, 0, 0);
+    b.emit(Op::LOAD_INT, 2, 0, 0, 1);
+    b.emit(Op::LOAD_INT, 4, 0, 0, 1);
+    b.emit(Op::LOAD_INT, 5, 0, 0, 3);
+    size_t prep = b.emit(Op::FOR_PREP, 4);
+    size_t body = b.here();
+    b.emit(Op::ADD_I, 1, 1, 2);
+    b.emit(Op::ADD_I, 2, 2, 2);
+    b.jumpTo(Op::FOR_LOOP, 4, body);
+    b.patch(prep, b.here());
+    size_t top = b.here();
+    b.emit(Op::ADD_I, 1, 1, 0);
+    b.emit(Op::LOAD_INT, 6, 0, 0, 100);
+    b.emit(Op::LT_I, 7, 1, 6);
+    b.jumpTo(Op::JUMP_IF_TRUE, 7, top);
+    b.emit(Op::RETURN, 1);
+
+    checkOptimized("loop-carried values", program, intArgs({ 1, 7, 50 }));
+}
+
+// Random structured routines: assignments, if/else on comparisons, and
+// counted loops with constant or argument bounds, nested two deep.
+class RandomRoutine {
+public:
+    explicit RandomRoutine(uint32_t seed) : random(seed) {}
+
+    Program generate() {
+        Program program;
+        RoutineBuilder b(addRoutine(program, 1));
+        builder = &b;
+        // Some variables start from the argument, so tests on them are not
+        // decided at compile time
+        for (uint8_t r = 1; r < VARIABLES; r++) {
+            b.emit(Op::LOAD_INT, r, 0, 0, pick(-3, 3));
+            if (pick(0, 2) == 0) b.emit(Op::SUB_I, r, 0, r);
+        }
+        block(0);
+        // Doubling folds wherever a value is known, so a wrong fact shows
+        b.emit(Op::LOAD_INT, TEMP, 0, 0, 31);
+        for (uint8_t r = 1; r < VARIABLES; r++) {
+            b.emit(Op::ADD_I, r, r, r);
+            b.emit(Op::MUL_I, 0, 0, TEMP);
+            b.emit(Op::ADD_I, 0, 0, r);
+        }
+        b.emit(Op::RETURN, 0);
+        return program;
+    }
+
+private:
+    static const uint8_t VARIABLES = 8; // r0 is the argument
+    static const uint8_t TEMP = 8;     // conditions, then 31 for the final sum
+    static const uint8_t LOOPS = 10;   // index and limit pairs from here
+
+    int pick(int low, int high) { return std::uniform_int_distribution<int>(low, high)(random); }
+    // One read in four is the argument, so enough tests are not decided
+    // at compile time
+    uint8_t variable() { return pick(0, 3) == 0 ? 0 : static_cast<uint8_t>(pick(1, VARIABLES - 1)); }
+    // The argument stays as passed, so loops up to it stay short
+    uint8_t target() { return static_cast<uint8_t>(pick(1, VARIABLES - 1)); }
+
+    void block(int depth) {
+        for (int count = pick(0, 4); count > 0; count--) {
+            int kind = pick(0, depth < 2 ? 9 : 5);
+            if (kind <= 5) assignment();
+            else if (kind <= 7) ifThen(depth);
+            else loop(depth);
+        }
+    }
+
+    void assignment() {
+        static const Op ops[] = { Op::ADD_I, Op::SUB_I, Op::MUL_I, Op::MOVE, Op::LOAD_INT, Op::NEG_I };
+        Op op = ops[pick(0, 5)];
+        if (op == Op::LOAD_INT) builder->emit(op, target(), 0, 0, pick(-4, 4));
+        else builder->emit(op, target(), variable(), variable());
+    }
+
+    void condition() {
+        static const Op ops[] = { Op::LT_I, Op::LE_I, Op::EQ_I, Op::NE_I };
+        if (pick(0, 2) == 0) builder->emit(Op::LOAD_INT, TEMP, 0, 0, pick(-2, 2));
+        else builder->emit(ops[pick(0, 3)], TEMP, variable(), variable());
+    }
+
+    // Tests either a fresh condition or a variable set earlier, so a test
+    // can also start a branch or follow a join
+    void ifThen(int depth) {
+        uint8_t tested = TEMP;
+        if (pick(0, 1) == 0) tested = variable();
+        else condition();
+        Op test = pick(0, 1) ? Op::JUMP_IF_FALSE : Op::JUMP_IF_TRUE;
+        size_t toElse = builder->emit(test, tested);
+        block(depth + 1);
+        if (pick(0, 1)) {
+            size_t toEnd = builder->emit(Op::JUMP);
+            builder->patch(toElse, builder->here());
+            // An else-if chain puts a test straight after the jump to the end
+            if (depth < 2 && pick(0, 2) == 0) ifThen(depth + 1);
+            else block(depth + 1);
+            builder->patch(toEnd, builder->here());
+        } else {
+            builder->patch(toElse, builder->here());
+        }
+    }
+
+    void loop(int depth) {
+        uint8_t index = static_cast<uint8_t>(LOOPS + 2 * depth);
+        bool reverse = pick(0, 1);
+        builder->emit(Op::LOAD_INT, index, 0, 0, pick(-1, 4));
+        if (pick(0, 3) == 0) builder->emit(Op::MOVE, index + 1, 0);
+        else builder->emit(Op::LOAD_INT, index + 1, 0, 0, pick(-1, 4));
+        size_t prep = builder->emit(reverse ? Op::FOR_PREP_REV : Op::FOR_PREP, index);
+        size_t body = builder->here();
+        block(depth + 1);
+        builder->emit(Op::ADD_I, target(), variable(), index);
+        builder->jumpTo(reverse ? Op::FOR_LOOP_REV : Op::FOR_LOOP, index, body);
+        builder->patch(prep, builder->here());
+    }
+
+    std::mt19937 random;
+    RoutineBuilder* builder = nullptr;
+};
+
+static void testRandomRoutines() {
+    for (uint32_t seed = 1; seed <= 20000; seed++) {
+        Program program = RandomRoutine(seed).generate();
+        std::string name = "random routine " + std::to_string(seed);
+        checkOptimized(name.c_str(), program, intArgs({ -2, 0, 1, 3 }));
+    }
+}
+
+int main() {
+    testRemovedJumpFallsThrough();
+    testRemovedLoopTestFallsThrough();
+    testFolding();
+    testBoundsChecks();
+    testByFieldArray();
+    testLoopCarriedValues();
+    testRandomRoutines();
+    return testStatus();
+}
@@ -0,0 +1,127 @@
+// relex() after an edit must leave the buffer as a fresh tokenize() of the
+// edited text would: same kinds, offsets, lengths, values and errors.
+// Identifier ids may differ, so identifiers are compared by name.
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "check.h"
+#include "lexer.h"
+
+static std::mt19937 rng(11);
+
+// Pieces that make tokens merge, split or turn into comments when edits
+// cut through them
+static const char* const PIECES[] = {
+    "x", "count", "integer", "is", "end", "1", "42", "3.5", "1..2", ":=", ":", "=", "/", "/=", "//", ".",
+    " ", "  ", "\t", "\n", "\r\n", "// note", "$", "@@", ";", "(", ")", "<=", "+", "*",
+};
+
+static std::string randomText(size_t pieces) {
+    std::string text;
+    for (size_t i = 0; i < pieces; i++) text += PIECES[rng() % (sizeof(PIECES) / sizeof(PIECES[0]))];
+    return text;
+}
+
+static size_t failedCases = 0;
+
+// Checks tokens against a fresh scan of text; returns false on the first
+// difference
+static bool sameAsFresh(const TokenBuffer& tokens, const std::string& text) {
+    TokenBuffer fresh;
+    tokenize(text.data(), text.size(), fresh, true);
+    if (tokens.size() != fresh.size() || tokens.errors.size() != fresh.errors.size()) return false;
+    for (size_t i = 0; i < fresh.size(); i++) {
+        if (tokens.kind(i) != fresh.kind(i) || tokens.offset(i) != fresh.offset(i)
+            || tokens.length(i) != fresh.length(i)) {
+            return false;
+        }
+        if (fresh.kind(i) == TokenKind::IDENTIFIER ? tokens.name(i) != fresh.name(i)
+                                                   : tokens.values[i] != fresh.values[i]) {
+            return false;
+        }
+    }
+    for (size_t i = 0; i < fresh.errors.size(); i++) {
+        if (tokens.errors[i].offset != fresh.errors[i].offset || tokens.errors[i].length != fresh.errors[i].length) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Replaces removed bytes at offset of text with inserted, relexes tokens
+// and checks the result and the TokenChange
+static void edit(std::string& text, TokenBuffer& tokens, size_t offset, size_t removed, const std::string& inserted) {
+    std::string before = text;
+    size_t oldSize = tokens.size();
+    text.replace(offset, removed, inserted);
+    TokenChange change = relex(text.data(), text.size(), tokens, TextEdit{ offset, removed, inserted.size() });
+    bool ok = sameAsFresh(tokens, text);
+    ok = ok && change.first + change.removed <= oldSize && tokens.size() == oldSize - change.removed + change.inserted;
+    if (!ok && failedCases++ < 5) {
+        std::cerr << "relex differs from tokenize after replacing " << removed << " bytes at " << offset << " of '"
+                  << before << "' with '" << inserted << "'" << std::endl;
+    }
+    CHECK(ok);
+}
+
+// Starts a case from a fresh scan of text and applies one edit
+static void editOnce(std::string text, size_t offset, size_t removed, const std::string& inserted) {
+    TokenBuffer tokens;
+    tokenize(text.data(), text.size(), tokens, true);
+    edit(text, tokens, offset, removed, inserted);
+}
+
+int main() {
+    const std::string lines = "var count : integer := 42; // the count\nx := count / 3.5\n$y := 1..2 @\n";
+
+    // At the start and the end of the input, and of an empty one
+    editOnce(lines, 0, 0, "z ");
+    editOnce(lines, 0, 4, "");
+    editOnce(lines, 0, lines.size(), "a b");
+    editOnce(lines, lines.size(), 0, "end");
+    editOnce(lines, lines.size() - 1, 1, "");
+    editOnce("", 0, 0, "x := 1\n");
+    editOnce("x", 1, 0, "y");
+    editOnce("x := 1", 0, 6, "");
+
+    // Inside comments: text, a new "//", a newline that ends the comment
+    // early, and removing the newline that ended it
+    size_t comment = lines.find("//");
+    editOnce(lines, comment + 5, 0, "more");
+    editOnce(lines, comment + 5, 0, "\nrest");
+    editOnce(lines, comment, 1, "");
+    editOnce(lines, comment + 1, 0, " ");
+    editOnce(lines, lines.find('\n'), 1, "");
+    editOnce(lines, lines.find('\n'), 1, " ");
+
+    // Merging and splitting tokens
+    editOnce(lines, lines.find(" : "), 1, "");           // "count:" stays two tokens
+    editOnce(lines, lines.find(":="), 0, " ");           // ":=" into ":" "="
+    editOnce(lines, lines.find("3.5") + 1, 1, "");       // "3.5" into "35"
+    editOnce(lines, lines.find("3.5") + 1, 0, ".");      // "3..5"
+    editOnce(lines, lines.find("/ "), 0, "/");           // division into a comment
+    editOnce(lines, lines.find("/ ") + 1, 1, "=");       // "/="
+    editOnce(lines, lines.find("$y"), 1, "");            // the error goes away
+    editOnce(lines, lines.find("x :="), 0, "@");         // a new error
+    editOnce(lines, lines.find("\n$"), 1, "");           // two lines into one
+    editOnce(lines, lines.find("count /") + 2, 0, "\n"); // one line into two
+
+    // Random edits to random texts, each case relexing the same buffer
+    // many times over
+    for (int round = 0; round < 300; round++) {
+        std::string text = randomText(rng() % 80);
+        TokenBuffer tokens;
+        tokenize(text.data(), text.size(), tokens, true);
+        for (int i = 0; i < 40; i++) {
+            size_t offset = rng() % (text.size() + 1);
+            if (rng() % 8 == 0) offset = rng() % 2 ? 0 : text.size();
+            size_t removed = rng() % 4 == 0 ? 0 : rng() % (std::min<size_t>(text.size() - offset, 12) + 1);
+            edit(text, tokens, offset, removed, randomText(rng() % 4));
+        }
+    }
+
+    return testStatus();
+}
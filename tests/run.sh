@@ -0,0 +1,51 @@
+#!/bin/sh
+# Builds and runs the tests:
+#   *_test.cpp  programs linked with the lexer library (lex.yy.cc built with
+#               -DLEXER_NO_MAIN); each exits non-zero on a failed check
+#   *_test.sh   scripts that build and compare lexer variants themselves;
+#               they get ROOT, WORK, FLEX, CXX and CXXFLAGS in the environment
+#
+# Usage: tests/run.sh [name ...]      (default: all tests)
+# Environment:
+#   FLEX, CXX, CXXFLAGS  tools and flags used for the build
+set -e
+
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+FLEX=${FLEX:-flex}
+CXX=${CXX:-g++}
+CXXFLAGS=${CXXFLAGS:--std=c++17 -O2 -pthread -Wall -Wextra}
+export ROOT FLEX CXX CXXFLAGS
+
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+if [ $# -gt 0 ]; then
+    tests=$*
+else
+    tests=$(cd "$ROOT/tests" && ls *_test.cpp *_test.sh 2>/dev/null | sed 's/\.[a-z]*$//')
+fi
+
+$FLEX -o "$WORK/lex.yy.cc" "$ROOT/lexer.l"
+# shellcheck disable=SC2086
+$CXX $CXXFLAGS -DLEXER_NO_MAIN -I"$ROOT" -c "$WORK/lex.yy.cc" -o "$WORK/lexer.o"
+
+failed=0
+for test in $tests; do
+    status=0
+    if [ -f "$ROOT/tests/$test.cpp" ]; then
+        # shellcheck disable=SC2086
+        $CXX $CXXFLAGS -I"$ROOT" "$ROOT/tests/$test.cpp" "$WORK/lexer.o" -o "$WORK/$test" \
+            && "$WORK/$test" || status=$?
+    else
+        mkdir -p "$WORK/$test"
+        WORK="$WORK/$test" sh "$ROOT/tests/$test.sh" || status=$?
+    fi
+    if [ $status -eq 0 ]; then
+        echo "PASS $test"
+    else
+        echo "FAIL $test"
+        failed=$((failed + 1))
+    fi
+done
+
+[ $failed -eq 0 ]
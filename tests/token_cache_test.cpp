@@ -0,0 +1,111 @@
+// Token cache entries round-trip the whole TokenBuffer, and damaged
+// entries are misses that leave the buffer as it was.
+
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "check.h"
+#include "content_hash.h"
+#include "lexer.h"
+#include "token_cache.h"
+
+namespace fs = std::filesystem;
+
+static const char SOURCE[] =
+    "routine main() is\n"
+    "    var count : integer := 42;\n"
+    "    var ratio : real := 2.5;\n"
+    "    count := count + limit * 9223372036854775807999; // saturates\n"
+    "    ratio := ratio / 0.125;\n"
+    "end\n";
+
+static void checkSame(const TokenBuffer& actual, const TokenBuffer& expected) {
+    CHECK_EQ(actual.size(), expected.size());
+    if (actual.size() != expected.size()) return;
+    for (size_t i = 0; i < expected.size(); i++) {
+        CHECK(actual.kind(i) == expected.kind(i));
+        CHECK_EQ(actual.offset(i), expected.offset(i));
+        CHECK_EQ(actual.length(i), expected.length(i));
+        if (expected.kind(i) == TokenKind::IDENTIFIER) {
+            CHECK_EQ(actual.name(i), expected.name(i));
+        } else {
+            CHECK_EQ(actual.values[i], expected.values[i]);
+        }
+    }
+}
+
+static void writeStream(const TokenBuffer& tokens, std::ostream& out) {
+    BinaryTokenWriter writer(out);
+    for (size_t i = 0; i < tokens.size(); i++) writer.put(tokens.kind(i), tokens.offset(i), tokens.length(i));
+    writer.finish();
+}
+
+static fs::path entryOf(const fs::path& dir) {
+    for (const fs::directory_entry& entry : fs::recursive_directory_iterator(dir)) {
+        if (entry.is_regular_file()) return entry.path();
+    }
+    return fs::path();
+}
+
+int main() {
+    char dirTemplate[] = "/tmp/token_cache_test.XXXXXX";
+    fs::path dir = mkdtemp(dirTemplate);
+    TokenCache cache(dir.string(), 1);
+    size_t size = sizeof(SOURCE) - 1;
+    uint64_t hash = contentHash(SOURCE, size);
+
+    TokenBuffer scanned;
+    CHECK(tokenize(SOURCE, size, scanned));
+    CHECK(!cache.load(hash, size, scanned));
+    CHECK(cache.store(hash, size, scanned));
+
+    TokenBuffer loaded;
+    CHECK(cache.load(hash, size, loaded));
+    checkSame(loaded, scanned);
+    CHECK_EQ(loaded.symbols.size(), scanned.symbols.size());
+
+    // Identifier ids are moved to the ids in the buffer loaded into
+    TokenBuffer prefixed;
+    prefixed.symbols.intern("limit");
+    prefixed.symbols.intern("other");
+    CHECK(cache.load(hash, size, prefixed));
+    checkSame(prefixed, scanned);
+
+    // A truncated entry, or one without the values (the old format), is a
+    // miss that leaves the buffer as it was, with no names interned, so
+    // later ids match a run without the cache
+    fs::path entry = entryOf(dir);
+    std::string bytes;
+    {
+        std::ifstream in(entry, std::ios::binary);
+        bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    std::ostringstream stream;
+    writeStream(scanned, stream);
+    std::string streamOnly = stream.str();
+    for (const std::string& damagedBytes : { bytes.substr(0, 3), bytes.substr(0, bytes.size() / 2),
+                                             bytes.substr(0, bytes.size() - 1), streamOnly }) {
+        {
+            std::ofstream out(entry, std::ios::binary | std::ios::trunc);
+            out.write(damagedBytes.data(), damagedBytes.size());
+        }
+        TokenBuffer damaged;
+        damaged.push(TokenKind::SEMICOLON, 0, 1);
+        damaged.symbols.intern("limit");
+        CHECK(!cache.load(hash, size, damaged));
+        CHECK_EQ(damaged.size(), size_t(1));
+        CHECK_EQ(damaged.symbols.size(), size_t(1));
+        CHECK_EQ(damaged.symbols.intern("count"), uint32_t(1));
+
+        TokenBuffer empty;
+        CHECK(!cache.load(hash, size, empty));
+        CHECK_EQ(empty.size(), size_t(0));
+        CHECK_EQ(empty.symbols.size(), size_t(0));
+    }
+
+    fs::remove_all(dir);
+    return testStatus();
+}
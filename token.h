@@ -0,0 +1,35 @@
+#ifndef TOKEN_H
+#define TOKEN_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// Token kinds produced by lexer.l, one byte each. The kinds are listed in
+// tokens.def.
+enum class TokenKind : uint8_t {
+    END = 0,
+#define TOKEN(name) name,
+#include "tokens.def"
+#undef TOKEN
+    COUNT
+};
+
+// Names of the token kinds as printed by the text output format. The
+// lengths are known at compile time, so writers copy them without strlen().
+inline constexpr std::string_view TOKEN_NAMES[] = {
+    "END",
+#define TOKEN(name) #name,
+#include "tokens.def"
+#undef TOKEN
+};
+
+inline std::string_view tokenNameView(TokenKind kind) {
+    return TOKEN_NAMES[static_cast<uint8_t>(kind)];
+}
+
+inline const char* tokenName(TokenKind kind) {
+    return tokenNameView(kind).data();
+}
+
+#endif // TOKEN_H
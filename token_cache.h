@@ -0,0 +1,160 @@
+#ifndef TOKEN_CACHE_H
+#define TOKEN_CACHE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "lexer.h"
+#include "mapped_file.h"
+#include "output_buffer.h"
+#include "token_stream.h"
+
+// Token buffers of earlier runs, keyed by the XXH64 of the input (see
+// contentHash() in content_hash.h), so unchanged files need not be scanned
+// again. Entries are stored under <dir>/<rules version>/: a lexer built
+// from different rules uses a different directory and never reads entries
+// written by another one. The cache is best effort. A missing or damaged
+// entry is a miss, and a failed store is ignored.
+//
+// An entry is a binary token stream (see token_stream.h) followed by the
+// rest of the TokenBuffer:
+//
+//   symbols : <varint count> { <varint length> <name bytes> }
+//   values  : <varint value> for every token, in order
+class TokenCache {
+public:
+    TokenCache(const std::string& dir, uint64_t rulesVersion) : root(std::filesystem::path(dir) / hex(rulesVersion)) {
+        std::error_code ec;
+        std::filesystem::create_directories(root, ec);
+    }
+
+    // Appends the tokens of the entry for an input of size bytes with this
+    // hash, with their values, and interns their identifiers into
+    // tokens.symbols. The entry is read into a buffer of its own first, so
+    // a damaged one leaves tokens, symbols included, as it was.
+    bool load(uint64_t hash, uint64_t size, TokenBuffer& tokens) const {
+        MappedFile entry;
+        if (!entry.open(path(hash, size).c_str())) return false;
+        const char* p = entry.data();
+        const char* end = p + entry.size();
+        if (entry.size() < sizeof(TOKEN_STREAM_MAGIC) + 1
+            || !std::equal(TOKEN_STREAM_MAGIC, TOKEN_STREAM_MAGIC + sizeof(TOKEN_STREAM_MAGIC), p)
+            || static_cast<uint8_t>(p[sizeof(TOKEN_STREAM_MAGIC)]) != TOKEN_STREAM_VERSION) {
+            return false;
+        }
+        p += sizeof(TOKEN_STREAM_MAGIC) + 1;
+
+        TokenBuffer loaded;
+        if (!readEntry(p, end, loaded)) return false; // truncated or damaged
+        if (tokens.empty() && tokens.symbols.size() == 0) {
+            loaded.errors = std::move(tokens.errors);
+            tokens = std::move(loaded);
+        } else {
+            tokens.append(loaded);
+        }
+        return true;
+    }
+
+    // Writes the entry to a temporary file and renames it into place, so
+    // concurrent runs never see half an entry.
+    bool store(uint64_t hash, uint64_t size, const TokenBuffer& tokens) const {
+        std::string target = path(hash, size);
+        std::vector<char> temp(target.begin(), target.end());
+        const char suffix[] = ".XXXXXX";
+        temp.insert(temp.end(), suffix, suffix + sizeof(suffix));
+        int fd = mkstemp(temp.data());
+        if (fd < 0) return false;
+        fchmod(fd, 0644);
+        ::close(fd);
+
+        bool ok;
+        {
+            std::ofstream out(temp.data(), std::ios::binary);
+            BinaryTokenWriter writer(out);
+            for (size_t i = 0; i < tokens.size(); i++) writer.put(tokens.kind(i), tokens.offset(i), tokens.length(i));
+            writer.finish();
+
+            OutputBuffer rest(out);
+            char number[10];
+            rest.write(number, encodeVarint(number, tokens.symbols.size()) - number);
+            for (uint32_t id = 0; id < tokens.symbols.size(); id++) {
+                std::string_view name = tokens.symbols.name(id);
+                rest.write(number, encodeVarint(number, name.size()) - number);
+                rest.write(name.data(), name.size());
+            }
+            for (uint64_t value : tokens.values) rest.write(number, encodeVarint(number, value) - number);
+            rest.flush();
+            out.close();
+            ok = static_cast<bool>(out);
+        }
+        std::error_code ec;
+        if (ok) std::filesystem::rename(temp.data(), target, ec);
+        if (!ok || ec) {
+            std::filesystem::remove(temp.data(), ec);
+            return false;
+        }
+        return true;
+    }
+
+private:
+    static std::string hex(uint64_t value) {
+        char text[17];
+        snprintf(text, sizeof(text), "%016llx", static_cast<unsigned long long>(value));
+        return text;
+    }
+
+    // Reads the token stream after its header, then the symbols and values
+    // that go with it, into the empty buffer tokens.
+    static bool readEntry(const char*& p, const char* end, TokenBuffer& tokens) {
+        uint64_t prevEnd = 0;
+        for (;;) {
+            if (p == end) return false;
+            uint8_t kind = static_cast<uint8_t>(*p++);
+            if (kind == static_cast<uint8_t>(TokenKind::END)) break;
+            uint64_t gap, length;
+            if (kind >= static_cast<uint8_t>(TokenKind::COUNT) || !decodeVarint(p, end, gap)
+                || !decodeVarint(p, end, length)) {
+                return false;
+            }
+            tokens.push(static_cast<TokenKind>(kind), prevEnd + gap, static_cast<uint32_t>(length));
+            prevEnd += gap + length;
+        }
+
+        uint64_t count;
+        if (!decodeVarint(p, end, count) || count > static_cast<uint64_t>(end - p)) return false;
+        std::vector<uint32_t> ids(count);
+        for (uint64_t id = 0; id < count; id++) {
+            uint64_t length;
+            if (!decodeVarint(p, end, length) || length > static_cast<uint64_t>(end - p)) return false;
+            ids[id] = tokens.symbols.intern(p, length);
+            p += length;
+        }
+        for (size_t i = 0; i < tokens.size(); i++) {
+            if (!decodeVarint(p, end, tokens.values[i])) return false;
+            if (tokens.kinds[i] == TokenKind::IDENTIFIER) {
+                if (tokens.values[i] >= count) return false;
+                tokens.values[i] = ids[tokens.values[i]];
+            }
+        }
+        return p == end;
+    }
+
+    std::string path(uint64_t hash, uint64_t size) const {
+        return (root / (hex(hash) + "-" + std::to_string(size) + ".tok")).string();
+    }
+
+    std::filesystem::path root;
+};
+
+#endif // TOKEN_CACHE_H
@@ -0,0 +1,159 @@
+#ifndef TOKEN_QUEUE_H
+#define TOKEN_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "lexer.h"
+#include "token.h"
+#include "trace.h"
+
+// A fixed-size block of tokens handed from the scanner thread to the
+// parser thread in one go, so the two threads touch the shared queue once
+// per TOKEN_BATCH_SIZE tokens rather than once per token.
+const size_t TOKEN_BATCH_SIZE = 4096;
+
+struct TokenBatch {
+    size_t count = 0;
+    TokenKind kinds[TOKEN_BATCH_SIZE];
+    uint64_t offsets[TOKEN_BATCH_SIZE];
+    uint32_t lengths[TOKEN_BATCH_SIZE];
+    uint64_t values[TOKEN_BATCH_SIZE];
+
+    bool full() const { return count == TOKEN_BATCH_SIZE; }
+
+    void push(TokenKind kind, uint64_t offset, uint32_t length, uint64_t value) {
+        kinds[count] = kind;
+        offsets[count] = offset;
+        lengths[count] = length;
+        values[count] = value;
+        count++;
+    }
+};
+
+struct TokenQueueStats {
+    uint64_t batches;
+    uint64_t producerStalls; // times the scanner found the queue full
+    uint64_t consumerStalls; // times the parser found the queue empty
+};
+
+// Bounded single-producer/single-consumer ring of TokenBatch slots. Batches
+// are filled and read in place. A full ring makes the producer wait, which
+// is the backpressure that keeps a slow parser from buffering the whole
+// input. Both sides wait by spinning with yield(), never with a lock.
+class TokenQueue {
+public:
+    static const size_t CAPACITY = 8;
+
+    TokenQueue() : head(0), tail(0), closed(false), batches(0), producerStalls(0), consumerStalls(0) {}
+
+    TokenQueue(const TokenQueue&) = delete;
+    TokenQueue& operator=(const TokenQueue&) = delete;
+
+    // Producer: next free slot, waiting while the ring is full.
+    TokenBatch& beginWrite() {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) == CAPACITY) {
+            LEXER_TRACE_SCOPE("queue full");
+            producerStalls.fetch_add(1, std::memory_order_relaxed);
+            while (h - tail.load(std::memory_order_acquire) == CAPACITY) std::this_thread::yield();
+        }
+        TokenBatch& batch = slots[h % CAPACITY];
+        batch.count = 0;
+        return batch;
+    }
+
+    // Producer: publishes the slot returned by beginWrite().
+    void commit() {
+        batches.fetch_add(1, std::memory_order_relaxed);
+        head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    // Producer: no more batches will follow.
+    void close() { closed.store(true, std::memory_order_release); }
+
+    // Consumer: oldest unread batch, waiting while the ring is empty, or
+    // nullptr once the producer has closed the queue and it is drained.
+    const TokenBatch* beginRead() {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (head.load(std::memory_order_acquire) == t) {
+            LEXER_TRACE_SCOPE("queue empty");
+            consumerStalls.fetch_add(1, std::memory_order_relaxed);
+            while (head.load(std::memory_order_acquire) == t) {
+                if (closed.load(std::memory_order_acquire)) {
+                    if (head.load(std::memory_order_acquire) == t) return nullptr;
+                    break;
+                }
+                std::this_thread::yield();
+            }
+        }
+        return &slots[t % CAPACITY];
+    }
+
+    // Consumer: hands the slot returned by beginRead() back to the producer.
+    void release() {
+        tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    TokenQueueStats stats() const {
+        return TokenQueueStats{ batches.load(), producerStalls.load(), consumerStalls.load() };
+    }
+
+private:
+    TokenBatch slots[CAPACITY];
+    alignas(64) std::atomic<size_t> head;
+    alignas(64) std::atomic<size_t> tail;
+    alignas(64) std::atomic<bool> closed;
+    std::atomic<uint64_t> batches;
+    std::atomic<uint64_t> producerStalls;
+    std::atomic<uint64_t> consumerStalls;
+};
+
+// Token-at-a-time view of a TokenQueue for the parser side; the parser's
+// yylex() calls next() until it returns false.
+class TokenQueueReader {
+public:
+    explicit TokenQueueReader(TokenQueue& queue) : queue(queue), batch(nullptr), index(0) {}
+
+    ~TokenQueueReader() {
+        if (batch) queue.release();
+    }
+
+    bool next(Token& token, uint64_t& value) {
+        if (batch && index == batch->count) {
+            queue.release();
+            batch = nullptr;
+        }
+        while (!batch) {
+            batch = queue.beginRead();
+            if (!batch) return false;
+            index = 0;
+            if (batch->count == 0) {
+                queue.release();
+                batch = nullptr;
+            }
+        }
+        token = Token{ batch->kinds[index], batch->offsets[index], batch->lengths[index] };
+        value = batch->values[index];
+        index++;
+        return true;
+    }
+
+private:
+    TokenQueue& queue;
+    const TokenBatch* batch;
+    size_t index;
+};
+
+// Scans data on the calling thread into queue, then closes it. Run it on
+// its own thread with a TokenQueueReader on another. Identifier values are
+// left 0: the symbol table would be shared between threads, so the parser
+// reads names from the input at the token offsets instead. Lexical errors
+// are handled as by tokenize() and, if errors is set, listed there.
+bool tokenizeToQueue(const char* data, size_t size, TokenQueue& queue, bool recover = false,
+                     std::vector<LexError>* errors = nullptr);
+
+#endif // TOKEN_QUEUE_H
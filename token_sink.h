@@ -0,0 +1,76 @@
+#ifndef TOKEN_SINK_H
+#define TOKEN_SINK_H
+
+#include <cstdint>
+
+#include "lexer.h"
+#include "token.h"
+#include "token_queue.h"
+
+// Token sinks for Lexer::scan(). A sink is any type with
+//
+//   static constexpr bool VALUES;   // whether it needs lexeme values
+//   void put(TokenKind kind, uint64_t offset, uint32_t length, uint64_t value);
+//   void finish();
+//
+// scan() is a template over the sink type, so put() is resolved at compile
+// time and inlined into the scan loop. TextTokenWriter and
+// BinaryTokenWriter in token_stream.h are sinks as well.
+
+// Appends to a TokenBuffer. Pass the buffer's symbols to scan() as well so
+// that identifiers get symbol ids.
+class TokenBufferSink {
+public:
+    static constexpr bool VALUES = true;
+
+    explicit TokenBufferSink(TokenBuffer& tokens) : tokens(tokens) {}
+
+    void put(TokenKind kind, uint64_t offset, uint32_t length, uint64_t value) {
+        tokens.push(kind, offset, length, value);
+    }
+
+    void finish() {}
+
+private:
+    TokenBuffer& tokens;
+};
+
+// Fills TokenQueue batches in place and publishes each one when it is full.
+// finish() publishes the last, partly filled batch but leaves the queue
+// open.
+class TokenQueueSink {
+public:
+    static constexpr bool VALUES = true;
+
+    explicit TokenQueueSink(TokenQueue& queue) : queue(queue), batch(nullptr) {}
+
+    void put(TokenKind kind, uint64_t offset, uint32_t length, uint64_t value) {
+        if (!batch) batch = &queue.beginWrite();
+        batch->push(kind, offset, length, value);
+        if (batch->full()) finish();
+    }
+
+    void finish() {
+        if (batch) {
+            queue.commit();
+            batch = nullptr;
+        }
+    }
+
+private:
+    TokenQueue& queue;
+    TokenBatch* batch;
+};
+
+// Only counts tokens, for measuring the scanner on its own.
+class CountingSink {
+public:
+    static constexpr bool VALUES = false;
+
+    void put(TokenKind, uint64_t, uint32_t, uint64_t) { count++; }
+    void finish() {}
+
+    uint64_t count = 0;
+};
+
+#endif // TOKEN_SINK_H
@@ -0,0 +1,86 @@
+#ifndef TOKEN_STATS_H
+#define TOKEN_STATS_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#include "token.h"
+
+// Token counts for --stats. Each scanner thread fills its own TokenStats,
+// which costs a couple of array increments per token; merge() adds them up
+// at the end.
+struct TokenStats {
+    // Identifiers longer than this share the last length bucket
+    static const size_t MAX_IDENTIFIER_LENGTH = 32;
+
+    uint64_t kinds[static_cast<size_t>(TokenKind::COUNT)] = {};
+    uint64_t identifierLengths[MAX_IDENTIFIER_LENGTH + 1] = {};
+    uint64_t tokenBytes = 0;
+    uint64_t inputBytes = 0;
+    uint64_t dfaBytes = 0; // input bytes left after squeezing whitespace and comments
+    std::chrono::nanoseconds inputTime{0};
+    std::chrono::nanoseconds squeezeTime{0};
+    std::chrono::nanoseconds outputTime{0};
+    // False when the scan ran where its time could not be split out (on
+    // -j or --pipeline threads, or replayed from the cache): input and
+    // squeeze times and dfaBytes are then not known
+    bool timed = true;
+    uint64_t cacheLookups = 0;
+    uint64_t cacheHits = 0;
+
+    void add(TokenKind kind, uint64_t length) {
+        kinds[static_cast<size_t>(kind)]++;
+        if (kind == TokenKind::IDENTIFIER) {
+            identifierLengths[std::min<uint64_t>(length, MAX_IDENTIFIER_LENGTH)]++;
+        }
+        tokenBytes += length;
+    }
+
+    uint64_t tokens() const {
+        uint64_t total = 0;
+        for (uint64_t count : kinds) total += count;
+        return total;
+    }
+
+    void merge(const TokenStats& other) {
+        for (size_t i = 0; i < static_cast<size_t>(TokenKind::COUNT); i++) kinds[i] += other.kinds[i];
+        for (size_t i = 0; i <= MAX_IDENTIFIER_LENGTH; i++) identifierLengths[i] += other.identifierLengths[i];
+        tokenBytes += other.tokenBytes;
+        inputBytes += other.inputBytes;
+        dfaBytes += other.dfaBytes;
+        inputTime += other.inputTime;
+        squeezeTime += other.squeezeTime;
+        outputTime += other.outputTime;
+        timed = timed && other.timed;
+        cacheLookups += other.cacheLookups;
+        cacheHits += other.cacheHits;
+    }
+};
+
+// Sink that counts each token into stats and passes it on to a writer
+// from token_stream.h. finish() also picks up the writer's output time.
+template <typename Writer>
+class StatsSink {
+public:
+    static constexpr bool VALUES = Writer::VALUES;
+
+    StatsSink(Writer& writer, TokenStats& stats) : writer(writer), stats(stats) {}
+
+    void put(TokenKind kind, uint64_t offset, uint64_t length, uint64_t value = 0) {
+        stats.add(kind, length);
+        writer.put(kind, offset, length, value);
+    }
+
+    void finish() {
+        writer.finish();
+        stats.outputTime += writer.writeTime();
+    }
+
+private:
+    Writer& writer;
+    TokenStats& stats;
+};
+
+#endif // TOKEN_STATS_H
@@ -0,0 +1,474 @@
+#ifndef TOKEN_STREAM_H
+#define TOKEN_STREAM_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "lz4_block.h"
+#include "output_buffer.h"
+#include "token.h"
+
+// Binary token stream format (--format=binary):
+//
+//   header : "ITOK" <version byte>
+//   token  : <kind byte> <varint gap> <varint length>
+//   end    : <kind byte TokenKind::END>
+//
+// "gap" is the number of bytes between the end of the previous token and
+// the start of this one (whitespace and comments), so offsets stay small
+// no matter how large the input is. Varints are LEB128: seven bits per
+// byte, least significant group first, high bit set on all but the last.
+
+const char TOKEN_STREAM_MAGIC[4] = { 'I', 'T', 'O', 'K' };
+const uint8_t TOKEN_STREAM_VERSION = 1;
+
+// Writes value as a varint at p and returns the position after it.
+inline char* encodeVarint(char* p, uint64_t value) {
+    while (value >= 0x80) {
+        *p++ = static_cast<char>((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    *p++ = static_cast<char>(value);
+    return p;
+}
+
+inline bool decodeVarint(std::istream& in, uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        int c = in.get();
+        if (c == EOF) return false;
+        value |= static_cast<uint64_t>(c & 0x7f) << shift;
+        if (!(c & 0x80)) return true;
+    }
+    return false;
+}
+
+// Same for a stream in memory: reads at p, which is moved past the varint.
+inline bool decodeVarint(const char*& p, const char* end, uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64 && p < end; shift += 7) {
+        unsigned char c = static_cast<unsigned char>(*p++);
+        value |= static_cast<uint64_t>(c & 0x7f) << shift;
+        if (!(c & 0x80)) return true;
+    }
+    return false;
+}
+
+// Text token stream format (--format=text): one token name per line.
+class TextTokenWriter {
+public:
+    static constexpr bool VALUES = false;
+
+    explicit TextTokenWriter(std::ostream& out) : out(out) {}
+
+    void put(TokenKind kind, uint64_t, uint64_t, uint64_t = 0) {
+        std::string_view name = tokenNameView(kind);
+        out.write(name.data(), name.size());
+        out.put('\n');
+    }
+
+    void finish() {
+        out.flush();
+    }
+
+    std::chrono::nanoseconds writeTime() const { return out.writeTime; }
+
+private:
+    OutputBuffer out;
+};
+
+class BinaryTokenWriter {
+public:
+    static constexpr bool VALUES = false;
+
+    explicit BinaryTokenWriter(std::ostream& out) : out(out), prevEnd(0) {
+        this->out.write(TOKEN_STREAM_MAGIC, sizeof(TOKEN_STREAM_MAGIC));
+        this->out.put(static_cast<char>(TOKEN_STREAM_VERSION));
+    }
+
+    void put(TokenKind kind, uint64_t offset, uint64_t length, uint64_t = 0) {
+        char record[1 + 2 * 10];
+        char* p = record;
+        *p++ = static_cast<char>(kind);
+        p = encodeVarint(p, offset - prevEnd);
+        p = encodeVarint(p, length);
+        out.write(record, p - record);
+        prevEnd = offset + length;
+    }
+
+    void finish() {
+        out.put(static_cast<char>(TokenKind::END));
+        out.flush();
+    }
+
+    std::chrono::nanoseconds writeTime() const { return out.writeTime; }
+
+private:
+    OutputBuffer out;
+    uint64_t prevEnd;
+};
+
+class BinaryTokenReader {
+public:
+    explicit BinaryTokenReader(std::istream& in) : in(in), prevEnd(0), valid(false) {
+        char magic[sizeof(TOKEN_STREAM_MAGIC)];
+        in.read(magic, sizeof(magic));
+        int version = in.get();
+        valid = in && std::equal(magic, magic + sizeof(magic), TOKEN_STREAM_MAGIC)
+                && version == TOKEN_STREAM_VERSION;
+    }
+
+    // False if the header is missing or of an unsupported version.
+    bool good() const { return valid; }
+
+    // Reads the next token. Returns false at the END marker or on a
+    // truncated stream.
+    bool next(TokenKind& kind, uint64_t& offset, uint64_t& length) {
+        if (!valid) return false;
+        int k = in.get();
+        if (k == EOF || k == static_cast<int>(TokenKind::END)) return false;
+        uint64_t gap;
+        if (k >= static_cast<int>(TokenKind::COUNT) || !decodeVarint(in, gap) || !decodeVarint(in, length)) {
+            valid = false;
+            return false;
+        }
+        kind = static_cast<TokenKind>(k);
+        offset = prevEnd + gap;
+        prevEnd = offset + length;
+        return true;
+    }
+
+private:
+    std::istream& in;
+    uint64_t prevEnd;
+    bool valid;
+};
+
+// Combined batch output (--combined): the binary token streams of many
+// files back to back, followed by an index saying where each one is.
+//
+//   bundle : "ITKB" <version byte> <token stream>... <index> <index offset>
+//   index  : <varint count> { <varint path length> <path> <varint offset> <varint length> }...
+//
+// The index offset is the last 8 bytes of the file, little endian. Stream
+// offsets are absolute, so a consumer can seek to one file's tokens and
+// read them with BinaryTokenReader.
+
+const char TOKEN_BUNDLE_MAGIC[4] = { 'I', 'T', 'K', 'B' };
+
+struct BundleEntry {
+    std::string path;
+    uint64_t offset;
+    uint64_t length;
+};
+
+inline void writeBundleHeader(std::ostream& out) {
+    out.write(TOKEN_BUNDLE_MAGIC, sizeof(TOKEN_BUNDLE_MAGIC));
+    out.put(static_cast<char>(TOKEN_STREAM_VERSION));
+}
+
+inline void writeBundleIndex(std::ostream& out, const std::vector<BundleEntry>& entries) {
+    uint64_t indexOffset = static_cast<uint64_t>(out.tellp());
+    char buf[10];
+    out.write(buf, encodeVarint(buf, entries.size()) - buf);
+    for (const BundleEntry& entry : entries) {
+        out.write(buf, encodeVarint(buf, entry.path.size()) - buf);
+        out.write(entry.path.data(), entry.path.size());
+        out.write(buf, encodeVarint(buf, entry.offset) - buf);
+        out.write(buf, encodeVarint(buf, entry.length) - buf);
+    }
+    for (int i = 0; i < 8; i++) {
+        out.put(static_cast<char>(indexOffset >> (8 * i)));
+    }
+}
+
+// Reads the index of a bundle. Returns false if in is not a bundle.
+inline bool readBundleIndex(std::istream& in, std::vector<BundleEntry>& entries) {
+    char magic[sizeof(TOKEN_BUNDLE_MAGIC)];
+    in.seekg(0);
+    in.read(magic, sizeof(magic));
+    if (!in || !std::equal(magic, magic + sizeof(magic), TOKEN_BUNDLE_MAGIC)
+        || in.get() != TOKEN_STREAM_VERSION) {
+        return false;
+    }
+
+    unsigned char tail[8];
+    in.seekg(-8, std::ios::end);
+    in.read(reinterpret_cast<char*>(tail), sizeof(tail));
+    if (!in) return false;
+    uint64_t indexOffset = 0;
+    for (int i = 0; i < 8; i++) {
+        indexOffset |= static_cast<uint64_t>(tail[i]) << (8 * i);
+    }
+
+    in.seekg(indexOffset);
+    uint64_t count;
+    if (!decodeVarint(in, count)) return false;
+    entries.clear();
+    for (uint64_t i = 0; i < count; i++) {
+        BundleEntry entry;
+        uint64_t pathLength;
+        if (!decodeVarint(in, pathLength)) return false;
+        entry.path.resize(pathLength);
+        in.read(&entry.path[0], pathLength);
+        if (!in || !decodeVarint(in, entry.offset) || !decodeVarint(in, entry.length)) return false;
+        entries.push_back(entry);
+    }
+    return true;
+}
+
+// Compressed token stream (--format=compressed): the binary token records
+// in LZ4 blocks of up to 64K tokens, with an index of the blocks at the end.
+//
+//   stream : "ITKZ" <version byte> <block>... <index> <index offset>
+//   block  : LZ4 block (lz4_block.h) of <kind byte> <varint gap> <varint length> records
+//   index  : <varint count> { <varint block offset> <varint compressed size>
+//                             <varint raw size> <varint tokens> <varint start> }...
+//
+// "start" is the source offset the block's first gap counts from, so each
+// block decodes on its own. As in a bundle, the index offset is the last 8
+// bytes of the file, little endian.
+
+const char COMPRESSED_STREAM_MAGIC[4] = { 'I', 'T', 'K', 'Z' };
+const size_t COMPRESSED_BLOCK_TOKENS = 64 * 1024;
+
+struct CompressedBlock {
+    uint64_t offset;
+    uint64_t compressedSize;
+    uint64_t rawSize;
+    uint64_t tokens;
+    uint64_t start;
+};
+
+class CompressedTokenWriter {
+public:
+    static constexpr bool VALUES = false;
+
+    explicit CompressedTokenWriter(std::ostream& out) : out(out), written(0), prevEnd(0), blockStart(0), blockTokens(0) {
+        this->out.write(COMPRESSED_STREAM_MAGIC, sizeof(COMPRESSED_STREAM_MAGIC));
+        this->out.put(static_cast<char>(TOKEN_STREAM_VERSION));
+        written = sizeof(COMPRESSED_STREAM_MAGIC) + 1;
+    }
+
+    void put(TokenKind kind, uint64_t offset, uint64_t length, uint64_t = 0) {
+        char record[1 + 2 * 10];
+        char* p = record;
+        *p++ = static_cast<char>(kind);
+        p = encodeVarint(p, offset - prevEnd);
+        p = encodeVarint(p, length);
+        raw.insert(raw.end(), record, p);
+        prevEnd = offset + length;
+        if (++blockTokens == COMPRESSED_BLOCK_TOKENS) flushBlock();
+    }
+
+    void finish() {
+        flushBlock();
+        uint64_t indexOffset = written;
+        char buf[10];
+        std::string index(buf, encodeVarint(buf, blocks.size()));
+        for (const CompressedBlock& block : blocks) {
+            const uint64_t fields[] = { block.offset, block.compressedSize, block.rawSize, block.tokens, block.start };
+            for (uint64_t field : fields) index.append(buf, encodeVarint(buf, field));
+        }
+        for (int i = 0; i < 8; i++) index.push_back(static_cast<char>(indexOffset >> (8 * i)));
+        out.write(index.data(), index.size());
+        out.flush();
+    }
+
+    std::chrono::nanoseconds writeTime() const { return out.writeTime; }
+
+private:
+    void flushBlock() {
+        if (blockTokens == 0) return;
+        compressed.resize(lz4Bound(raw.size()));
+        size_t size = lz4Compress(raw.data(), raw.size(), compressed.data());
+        out.write(compressed.data(), size);
+        blocks.push_back(CompressedBlock{ written, size, raw.size(), blockTokens, blockStart });
+        written += size;
+        raw.clear();
+        blockTokens = 0;
+        blockStart = prevEnd;
+    }
+
+    OutputBuffer out;
+    uint64_t written;
+    uint64_t prevEnd;
+    uint64_t blockStart;
+    uint64_t blockTokens;
+    std::vector<char> raw;
+    std::vector<char> compressed;
+    std::vector<CompressedBlock> blocks;
+};
+
+// Random access to a compressed stream: reads the index on open(), then
+// decompresses only the blocks a request touches.
+class CompressedTokenReader {
+public:
+    explicit CompressedTokenReader(std::istream& in) : in(in), total(0), cached(SIZE_MAX) {}
+
+    // Reads the index. Returns false if in is not a compressed stream, or
+    // if the index does not fit the file: the blocks must lie back to back
+    // between the header and the index, and no size may be more than its
+    // block can hold, so a damaged index cannot make load() allocate more
+    // than the file could expand to.
+    bool open() {
+        bool ok = readIndex();
+        if (!ok) {
+            blocks.clear();
+            firstTokens.clear();
+            total = 0;
+        }
+        cached = SIZE_MAX;
+        return ok;
+    }
+
+    uint64_t tokenCount() const { return total; }
+    const std::vector<CompressedBlock>& index() const { return blocks; }
+
+    // Calls f(kind, offset, length) for tokens first .. first + count - 1,
+    // or up to the last token. Returns false on a damaged block.
+    template<class F>
+    bool read(uint64_t first, uint64_t count, F&& f) {
+        uint64_t last = std::min(total, first + count);
+        while (first < last) {
+            size_t b = blockOf(first);
+            if (!load(b)) return false;
+            uint64_t base = firstTokens[b];
+            uint64_t end = std::min(last, base + blocks[b].tokens);
+            for (uint64_t t = first; t < end; t++) {
+                size_t i = static_cast<size_t>(t - base);
+                f(kinds[i], offsets[i], lengths[i]);
+            }
+            first = end;
+        }
+        return true;
+    }
+
+    // Index of the first token that ends after source offset, or
+    // tokenCount() if there is none. For a line, pass the offset of its
+    // start, from LineIndex::lineStart().
+    uint64_t tokenAt(uint64_t offset) {
+        // The last block starting at or before offset
+        size_t b = 0;
+        for (size_t lo = 0, hi = blocks.size(); lo < hi; ) {
+            size_t mid = (lo + hi) / 2;
+            if (blocks[mid].start <= offset) b = mid, lo = mid + 1;
+            else hi = mid;
+        }
+        for (; b < blocks.size(); b++) {
+            if (!load(b)) return total;
+            for (size_t i = 0; i < kinds.size(); i++) {
+                if (offsets[i] + lengths[i] > offset) return firstTokens[b] + i;
+            }
+        }
+        return total;
+    }
+
+private:
+    bool readIndex() {
+        blocks.clear();
+        firstTokens.clear();
+        total = 0;
+        const uint64_t header = sizeof(COMPRESSED_STREAM_MAGIC) + 1;
+        char magic[sizeof(COMPRESSED_STREAM_MAGIC)];
+        in.clear();
+        in.seekg(0);
+        in.read(magic, sizeof(magic));
+        if (!in || !std::equal(magic, magic + sizeof(magic), COMPRESSED_STREAM_MAGIC)
+            || in.get() != TOKEN_STREAM_VERSION) {
+            return false;
+        }
+        in.seekg(0, std::ios::end);
+        std::streamoff fileSize = in.tellg();
+        if (fileSize < static_cast<std::streamoff>(header + 1 + 8)) return false;
+        uint64_t indexEnd = static_cast<uint64_t>(fileSize) - 8;
+        unsigned char tail[8];
+        in.seekg(-8, std::ios::end);
+        in.read(reinterpret_cast<char*>(tail), sizeof(tail));
+        if (!in) return false;
+        uint64_t indexOffset = 0;
+        for (int i = 0; i < 8; i++) indexOffset |= static_cast<uint64_t>(tail[i]) << (8 * i);
+        if (indexOffset < header || indexOffset >= indexEnd) return false;
+
+        in.seekg(indexOffset);
+        uint64_t count;
+        if (!decodeVarint(in, count) || count > (indexEnd - indexOffset) / 5) return false;
+        uint64_t next = header;
+        for (uint64_t i = 0; i < count; i++) {
+            CompressedBlock block;
+            if (!decodeVarint(in, block.offset) || !decodeVarint(in, block.compressedSize)
+                || !decodeVarint(in, block.rawSize) || !decodeVarint(in, block.tokens)
+                || !decodeVarint(in, block.start)) {
+                return false;
+            }
+            // An LZ4 block expands at most 255 times, and a token record
+            // takes at least 3 bytes
+            if (block.offset != next || block.compressedSize > indexOffset - next
+                || block.rawSize > 255 * block.compressedSize || block.tokens > block.rawSize / 3) {
+                return false;
+            }
+            next += block.compressedSize;
+            blocks.push_back(block);
+            firstTokens.push_back(total);
+            total += block.tokens;
+        }
+        return next == indexOffset && in.tellg() == static_cast<std::streamoff>(indexEnd);
+    }
+
+    size_t blockOf(uint64_t token) const {
+        return static_cast<size_t>(std::upper_bound(firstTokens.begin(), firstTokens.end(), token) - firstTokens.begin()) - 1;
+    }
+
+    // Decodes block b into kinds/offsets/lengths, keeping the last one
+    bool load(size_t b) {
+        if (cached == b) return true;
+        cached = SIZE_MAX;
+        const CompressedBlock& block = blocks[b];
+        compressed.resize(block.compressedSize);
+        raw.resize(block.rawSize);
+        in.clear();
+        in.seekg(block.offset);
+        in.read(compressed.data(), compressed.size());
+        if (!in || !lz4Decompress(compressed.data(), compressed.size(), raw.data(), raw.size())) return false;
+
+        kinds.clear();
+        offsets.clear();
+        lengths.clear();
+        const char* p = raw.data();
+        const char* end = p + raw.size();
+        uint64_t prevEnd = block.start;
+        for (uint64_t t = 0; t < block.tokens; t++) {
+            uint64_t gap, length;
+            if (p == end || static_cast<uint8_t>(*p) >= static_cast<uint8_t>(TokenKind::COUNT)) return false;
+            TokenKind kind = static_cast<TokenKind>(*p++);
+            if (!decodeVarint(p, end, gap) || !decodeVarint(p, end, length)) return false;
+            kinds.push_back(kind);
+            offsets.push_back(prevEnd + gap);
+            lengths.push_back(length);
+            prevEnd += gap + length;
+        }
+        if (p != end) return false;
+        cached = b;
+        return true;
+    }
+
+    std::istream& in;
+    std::vector<CompressedBlock> blocks;
+    std::vector<uint64_t> firstTokens;
+    uint64_t total;
+
+    size_t cached; // block held in kinds/offsets/lengths
+    std::vector<char> compressed;
+    std::vector<char> raw;
+    std::vector<TokenKind> kinds;
+    std::vector<uint64_t> offsets;
+    std::vector<uint64_t> lengths;
+};
+
+#endif // TOKEN_STREAM_H
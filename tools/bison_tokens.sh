@@ -0,0 +1,21 @@
+#!/bin/sh
+# Prints Bison %token declarations for the kinds in tokens.def, numbered as
+# in TokenKind, so the parser's yylex() can return static_cast<int>(kind)
+# as is and the parser shares the lexer's one-byte kinds.
+#
+# Usage: tools/bison_tokens.sh [tokens.def]
+#
+# Bison has no include directive; put the output in front of the grammar:
+#   { tools/bison_tokens.sh; cat parser.y; } > build/parser.y
+set -e
+
+DEF=${1:-$(cd "$(dirname "$0")/.." && pwd)/tokens.def}
+
+echo "/* Generated from tokens.def by tools/bison_tokens.sh */"
+echo "%token END 0"
+awk '/^TOKEN\(/ {
+    name = $0
+    sub(/^TOKEN\(/, "", name)
+    sub(/\).*/, "", name)
+    printf "%%token %s %d\n", name, ++kind
+}' "$DEF"
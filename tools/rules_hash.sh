@@ -0,0 +1,11 @@
+#!/bin/sh
+# Prints the token cache version for -DLEXER_RULES_HASH: a hash of the
+# files that decide which tokens the lexer produces, so cache entries stay
+# valid across rebuilds until the rules change.
+#
+# Usage: g++ ... -DLEXER_RULES_HASH=$(tools/rules_hash.sh) lex.yy.cc
+set -e
+
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+
+echo "0x$(cat "$ROOT/lexer.l" "$ROOT/tokens.def" "$ROOT/keywords.h" | sha256sum | cut -c1-16)"
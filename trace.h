@@ -0,0 +1,127 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+// Scoped markers around the lexer's hot spots: flex buffer refills, the
+// scan loop, output block writes and pipeline queue waits. They are
+// compiled out unless the build selects a backend:
+//
+//   -DLEXER_TRACE_TRACY   Tracy zones (add Tracy's include path and link
+//                         its client, TracyClient.cpp)
+//   -DLEXER_TRACE_CHROME  Chrome trace JSON, written at exit to
+//                         $LEXER_TRACE_FILE or lexer-trace.json; open it in
+//                         chrome://tracing or Perfetto
+//
+// Without either, LEXER_TRACE_SCOPE(name) expands to nothing. name must be
+// a string literal.
+
+#if defined(LEXER_TRACE_TRACY)
+
+#include <tracy/Tracy.hpp>
+
+#define LEXER_TRACE_SCOPE(name) ZoneScopedN(name)
+
+#elif defined(LEXER_TRACE_CHROME)
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace trace {
+
+struct Event {
+    const char* name;
+    uint64_t start;    // microseconds since the recorder was created
+    uint64_t duration; // microseconds
+};
+
+// Each thread appends to its own event list; the lists are only read at
+// exit, after the threads are done.
+struct ThreadEvents {
+    unsigned tid;
+    std::vector<Event> events;
+};
+
+class Recorder {
+public:
+    static Recorder& instance() {
+        static Recorder recorder;
+        return recorder;
+    }
+
+    ~Recorder() { write(); }
+
+    uint64_t now() const {
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - epoch)
+            .count();
+    }
+
+    ThreadEvents& local() {
+        thread_local ThreadEvents* events = nullptr;
+        if (!events) {
+            std::lock_guard<std::mutex> lock(mutex);
+            threads.emplace_back(new ThreadEvents{ static_cast<unsigned>(threads.size() + 1), {} });
+            events = threads.back().get();
+        }
+        return *events;
+    }
+
+private:
+    Recorder() : epoch(std::chrono::steady_clock::now()) {}
+
+    void write() {
+        const char* path = getenv("LEXER_TRACE_FILE");
+        FILE* out = fopen(path ? path : "lexer-trace.json", "w");
+        if (!out) return;
+        fputs("{\"traceEvents\":[\n", out);
+        bool first = true;
+        for (const std::unique_ptr<ThreadEvents>& thread : threads) {
+            for (const Event& event : thread->events) {
+                fprintf(out, "%s{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%llu,\"dur\":%llu,\"pid\":1,\"tid\":%u}",
+                        first ? "" : ",\n", event.name, static_cast<unsigned long long>(event.start),
+                        static_cast<unsigned long long>(event.duration), thread->tid);
+                first = false;
+            }
+        }
+        fputs("\n]}\n", out);
+        fclose(out);
+    }
+
+    std::chrono::steady_clock::time_point epoch;
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ThreadEvents>> threads;
+};
+
+class Scope {
+public:
+    explicit Scope(const char* name) : name(name), start(Recorder::instance().now()) {}
+
+    ~Scope() {
+        Recorder& recorder = Recorder::instance();
+        recorder.local().events.push_back(Event{ name, start, recorder.now() - start });
+    }
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+private:
+    const char* name;
+    uint64_t start;
+};
+
+} // namespace trace
+
+#define LEXER_TRACE_JOIN2(a, b) a##b
+#define LEXER_TRACE_JOIN(a, b) LEXER_TRACE_JOIN2(a, b)
+#define LEXER_TRACE_SCOPE(name) trace::Scope LEXER_TRACE_JOIN(traceScope, __LINE__)(name)
+
+#else
+
+#define LEXER_TRACE_SCOPE(name)
+
+#endif
+
+#endif // TRACE_H